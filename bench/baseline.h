@@ -0,0 +1,99 @@
+#pragma once
+
+// The evaluator the compiled program replaced: a boost visitor walking the
+// parsed expression for every event. Kept here, reading the fields through
+// event_traits, as the reference the predicate figures are measured against.
+#include "lspredicate/ast.hpp"
+#include "lspredicate/event_traits.hpp"
+
+#include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
+#include "fmt/format.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace baseline
+{
+  template<typename Event>
+  struct CmdlExpressionEvaluator
+  {
+    using event_t = Event;
+    using traits = lsp::predicate::event_traits<Event>;
+    using result_type = bool;
+
+    const event_t& _event;
+
+    CmdlExpressionEvaluator(const event_t& event)
+      : _event(event)
+    {}
+
+    bool operator()(bool ast) const
+    {
+      return ast;
+    }
+
+    bool operator()(lspredicate::ast::comparison const& ast) const
+    {
+      if (ast.operation_.operator_ != lspredicate::ast::comparison_operator::EQ
+	  && ast.operation_.operator_ != lspredicate::ast::comparison_operator::NEQ)
+	throw std::runtime_error("The baseline only compares with == and !=");
+
+      bool result = true;
+      switch(ast.identifier)
+      {
+	case lspredicate::ast::comparison_identifier::EVENT:
+	  result = (traits::code(_event) == boost::get<long>(ast.operation_.operand_));
+	  break;
+	case lspredicate::ast::comparison_identifier::FILE_PATH:
+	  result = (traits::filename(_event) == boost::get<std::string>(ast.operation_.operand_));
+	  break;
+	case lspredicate::ast::comparison_identifier::PROCESS_PATH:
+	  result = (traits::process(_event) == boost::get<std::string>(ast.operation_.operand_));
+	  break;
+	case lspredicate::ast::comparison_identifier::PROCESS_PID:
+	  result = (traits::pid(_event) == boost::get<long>(ast.operation_.operand_));
+	  break;
+	case lspredicate::ast::comparison_identifier::PROCESS_UID:
+	  result = (traits::uid(_event) == boost::get<long>(ast.operation_.operand_));
+	  break;
+	case lspredicate::ast::comparison_identifier::PROCESS_GID:
+	  result = (traits::gid(_event) == boost::get<long>(ast.operation_.operand_));
+	  break;
+	default:
+	  throw std::runtime_error(fmt::format("Unknown identifier index: {0}", static_cast<long>(ast.identifier)));
+      }
+      if (ast.operation_.operator_  == lspredicate::ast::comparison_operator::NEQ)
+	result = !result;
+      return result;
+    }
+
+    bool operator()(lspredicate::ast::negated const& ast) const
+    {
+      bool r = boost::apply_visitor(*this, ast.operand_);
+      return (ast.sign == '!' ? !r : r);
+    }
+
+    bool operator()(lspredicate::ast::disjunctive_expression const& ast) const
+    {
+      bool result = boost::apply_visitor(*this, ast.head);
+      for (auto it = std::begin(ast.tail), endIt = std::end(ast.tail); (it != endIt) && !result; ++it)
+	result = boost::apply_visitor(*this, it->operand_);
+      return result;
+    }
+
+    bool operator()(lspredicate::ast::conjunctive_expression const& ast) const
+    {
+      bool result = boost::apply_visitor(*this, ast.head);
+      for (auto it = std::begin(ast.tail), endIt = std::end(ast.tail); (it != endIt) && result; ++it)
+	result = boost::apply_visitor(*this, it->operand_);
+      return result;
+    }
+  };
+
+  template<typename Event>
+    bool evaluate(const Event& event, lspredicate::ast::expression const& ast)
+    {
+      return CmdlExpressionEvaluator<Event>{event}(ast);
+    }
+} // baseline
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <cstddef>
+
+namespace bench
+{
+  using clock = std::chrono::steady_clock;
+
+  inline double seconds(clock::time_point start)
+  {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+  // keeps the compiler from dropping a result that is never used
+  template<typename T>
+    inline void keep(const T& value)
+    {
+      asm volatile("" : : "g"(&value) : "memory");
+    }
+
+  // runs f() count times, five times over, and prints the best time per
+  // call, or per item if each call handles several
+  template<typename F>
+    double perCall(const std::string& name, size_t count, F&& f, size_t items = 1)
+    {
+      double ns = 0;
+      for (int repeat = 0; repeat < 5; ++repeat)
+      {
+	auto start = clock::now();
+	for (size_t i = 0; i < count; ++i)
+	  f();
+	double once = seconds(start) * 1e9 / (count * items);
+	ns = (repeat ? std::min(ns, once) : once);
+      }
+      fmt::print("  {0:>8.1f} ns  {1}\n", ns, name);
+      return ns;
+    }
+} // bench
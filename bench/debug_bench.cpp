@@ -0,0 +1,48 @@
+// Per event debug logging: spdlog::debug() with a stringify() evaluated
+// eagerly against LSP_DEBUG, with debug off (the default) and with debug on
+// into a sink that drops everything.
+#include "bench.h"
+#include "debug.h"
+#include "lsprobe_event.h"
+
+#include "spdlog/sinks/null_sink.h"
+
+namespace
+{
+  constexpr size_t count = 1 << 20;
+
+  void measure(const lsp::FileEventView& event)
+  {
+    bench::perCall("spdlog::debug(\"{0}\", event.stringify())", count, [&event]
+	{
+	  spdlog::debug("only | {0}", event.stringify());
+	});
+    bench::perCall("LSP_DEBUG(\"{0}\", event.stringify())", count, [&event]
+	{
+	  LSP_DEBUG("only | {0}", event.stringify());
+	});
+  }
+}
+
+int main()
+{
+  lsp_cred_t pcred{};
+  pcred.tgid = 1234;
+  pcred.uid = 1000;
+  pcred.gid = 1000;
+  lsp::FileEventView event(nullptr, LSP_EVENT_CODE_OPEN, pcred
+      , "/home/user/projects/lsmonitor/file_event/lsprobe_event.h", "/usr/bin/vim");
+
+  spdlog::set_default_logger(spdlog::create<spdlog::sinks::null_sink_mt>("null"));
+#if defined(LSMONITOR_NO_HOT_DEBUG)
+  fmt::print("LSP_DEBUG is compiled out (LSMONITOR_HOT_DEBUG=OFF)\n");
+#endif
+
+  fmt::print("Debug off:\n");
+  spdlog::set_level(spdlog::level::info);
+  measure(event);
+
+  fmt::print("Debug on, into a null sink:\n");
+  spdlog::set_level(spdlog::level::debug);
+  measure(event);
+}
@@ -0,0 +1,76 @@
+// Two sources, each pushing batches through a chain of stages that post
+// the next one, as the pipeline channels do: on stlab::default_executor,
+// and on lsp::Executor with stealing and with sticky sources. Every stage
+// reads and writes the whole batch, so keeping it on one core shows.
+#include "bench.h"
+#include "executor.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  constexpr unsigned sources = 2;
+  constexpr unsigned stages = 4;
+  constexpr size_t batches = 50000; // per source
+  constexpr size_t batchSize = 512; // longs, 4 KB
+
+  struct Run
+  {
+    std::atomic<size_t> done{};
+  };
+
+  void stage(lsp::Executor::Handle handle, std::shared_ptr<std::vector<long>> batch, unsigned next, Run& run)
+  {
+    for (auto& value : *batch)
+      value += next;
+    if (next + 1 == stages)
+    {
+      run.done.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    handle([handle, batch = std::move(batch), next, &run]() mutable {stage(handle, std::move(batch), next + 1, run);});
+  }
+
+  void measure(const std::string& name, lsp::Executor * executor)
+  {
+    Run run;
+    auto start = bench::clock::now();
+    std::vector<std::thread> producers;
+    for (unsigned source = 0; source < sources; ++source)
+    {
+      lsp::Executor::Handle handle = (executor ? executor->handle(source) : lsp::Executor::Handle{});
+      producers.emplace_back([handle, &run]
+	  {
+	    for (size_t i = 0; i < batches; ++i)
+	    {
+	      auto batch = std::make_shared<std::vector<long>>(batchSize, long(i));
+	      handle([handle, batch = std::move(batch), &run]() mutable {stage(handle, std::move(batch), 0, run);});
+	    }
+	  });
+    }
+    for (auto& producer : producers)
+      producer.join();
+    while (run.done.load() < sources * batches)
+      std::this_thread::yield();
+
+    double elapsed = bench::seconds(start);
+    fmt::print("  {0:>8.1f} ms  {1:>8.0f} batches/s  {2}\n", elapsed * 1e3, sources * batches / elapsed, name);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  unsigned workers = (argc > 1 ? std::atoi(argv[1]) : std::max(2u, std::thread::hardware_concurrency()));
+  fmt::print("{0} sources of {1} batches through {2} stages, {3} workers:\n", sources, batches, stages, workers);
+
+  measure("stlab::default_executor", nullptr);
+  for (bool sticky : {false, true})
+  {
+    lsp::Executor executor({workers, {}, sticky});
+    measure((sticky ? "lsp::Executor, sticky" : "lsp::Executor, stealing"), &executor);
+  }
+}
@@ -0,0 +1,230 @@
+// Per event cost of evaluating predicates, over a fixed set of events with
+// a few hundred distinct files and processes. The AST visitor in baseline.h
+// is the reference the compiled program is measured against.
+#include "bench.h"
+#include "baseline.h"
+#include "cmdl_expression.h"
+#include "lanes.hpp"
+#include "lsprobe_event.h"
+#include "fanotify_event.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  constexpr size_t eventCount = 1 << 16;
+  constexpr size_t rounds = 16;
+
+  std::vector<std::string> strings(const char * prefix, size_t count)
+  {
+    std::vector<std::string> made;
+    for (size_t i = 0; i < count; ++i)
+      made.push_back(fmt::format("{0}/{1}", prefix, i));
+    return made;
+  }
+
+  std::vector<lsp::FileEventView> lsprobeEvents()
+  {
+    // the views point into them
+    static const auto files = strings("/home/user/projects/lsmonitor/file", 512);
+    static const auto processes = strings("/usr/bin/process", 64);
+    std::mt19937 random(1);
+    std::vector<lsp::FileEventView> events;
+    events.reserve(eventCount);
+    for (size_t i = 0; i < eventCount; ++i)
+    {
+      lsp_cred_t pcred{};
+      pcred.tgid = 1 + random() % 256;
+      pcred.uid = random() % 4 * 1000;
+      pcred.gid = pcred.uid;
+      events.emplace_back(nullptr, static_cast<lsp_event_code_t>(1 + random() % 2), pcred
+	  , files[random() % files.size()], processes[random() % processes.size()]);
+    }
+    return events;
+  }
+
+  // the same events, owned as the pipeline holds them
+  std::vector<std::unique_ptr<lsp::FileEvent>> lsprobeOwned(const std::vector<lsp::FileEventView>& views)
+  {
+    std::vector<std::unique_ptr<lsp::FileEvent>> events;
+    for (const auto& view : views)
+      events.push_back(std::make_unique<lsp::FileEvent>(view));
+    return events;
+  }
+
+  std::vector<std::unique_ptr<fan::FileEvent>> fanotifyOwned(const std::vector<lsp::FileEventView>& views)
+  {
+    std::vector<std::unique_ptr<fan::FileEvent>> events;
+    for (const auto& view : views)
+    {
+      auto event = std::make_unique<fan::FileEvent>();
+      event->code = (view.code == LSP_EVENT_CODE_OPEN ? fan::EventCode::OPEN : fan::EventCode::CLOSE);
+      event->pid = view.pcred.tgid;
+      event->uid = view.pcred.uid;
+      event->gid = view.pcred.gid;
+      event->filename = view.filename;
+      event->process = view.process;
+      event->filenameSymbol = view.filenameSymbol;
+      event->processSymbol = view.processSymbol;
+      events.push_back(std::move(event));
+    }
+    return events;
+  }
+
+  template<typename Predicate, typename Events>
+    void evaluate(const std::string& name, const Predicate& predicate, const Events& events)
+    {
+      size_t passed = 0;
+      size_t i = 0;
+      bench::perCall(name, events.size() * rounds, [&]
+	  {
+	    passed += predicate(events[i]);
+	    i = (i + 1 == events.size() ? 0 : i + 1);
+	  });
+      bench::keep(passed);
+    }
+
+  // the parsed expression of the predicate, walked by the baseline visitor
+  struct Visited
+  {
+    const lspredicate::ast::expression& _expr;
+
+    template<typename Event>
+      bool operator()(const Event& event) const
+      {
+	return baseline::evaluate(event, _expr);
+      }
+  };
+
+  const std::vector<std::string> expressions{
+    "(pid == 1)"
+    , "(uid == 0) && (pid != 1)"
+    , "(file == \"/home/user/projects/lsmonitor/file/7\") || ((pid != 1) && (process == \"/usr/bin/process/3\"))"
+    , "((uid == 1000) || (uid == 2000)) && ((pid == 12) || (pid == 13) || (pid == 14)) && (process != \"/usr/bin/process/1\")"
+  };
+
+  void compiled()
+  {
+    fmt::print("Compiled program against the AST visitor, per lsprobe event:\n");
+    auto events = lsprobeEvents();
+    for (const auto& expression : expressions)
+    {
+      fmt::print("{0}:\n", expression);
+      lsp::predicate::CmdlExpression predicate(expression);
+      evaluate("program", predicate, events);
+      evaluate("AST visitor", Visited{predicate._expr}, events);
+    }
+  }
+
+  // pid and file sets of sizes across the range, as a set from a file and,
+  // up to 1000 entries, as the equivalent chain of == (at 100k it would take
+  // about half a millisecond per event)
+  void membership()
+  {
+    auto events = lsprobeEvents();
+    events.resize(events.size() / 16); // the long chains take microseconds per event
+    for (size_t size : {10, 1000, 100000})
+    {
+      // pids 1..256 occur, every 64th entry of the set is one of them
+      std::string pids = fmt::format("/tmp/lsmonitor-bench-pids-{0}", size);
+      std::string files = fmt::format("/tmp/lsmonitor-bench-files-{0}", size);
+      std::string pidChain;
+      std::string fileChain;
+      {
+	std::ofstream pidSet(pids);
+	std::ofstream fileSet(files);
+	for (size_t i = 0; i < size; ++i)
+	{
+	  long pid = (i % 64 ? 1000 + long(i) : 1 + long(i / 64) % 256);
+	  std::string file = fmt::format("/home/user/projects/lsmonitor/file/{0}", (i % 64 ? 1000 + i : i / 64 % 512));
+	  pidSet << pid << '\n';
+	  fileSet << file << '\n';
+	  pidChain += fmt::format("{0}(pid == {1})", (i ? " || " : ""), pid);
+	  fileChain += fmt::format("{0}(file == \"{1}\")", (i ? " || " : ""), file);
+	}
+      }
+
+      auto run = [&events](const std::string& name, const std::string& expression)
+	{
+	  auto start = bench::clock::now();
+	  lsp::predicate::CmdlExpression predicate(expression);
+	  fmt::print("  {0:>8.1f} ms  to compile {1}\n", bench::seconds(start) * 1e3, name);
+	  evaluate(name, predicate, events);
+	};
+
+      fmt::print("{0} entries:\n", size);
+      run("pid in @FILE", fmt::format("(pid in @{0})", pids));
+      run("file in @FILE", fmt::format("(file in @{0})", files));
+      if (size <= 1000)
+      {
+	run("pid == chain", pidChain);
+	run("file == chain", fileChain);
+      }
+      std::remove(pids.c_str());
+      std::remove(files.c_str());
+    }
+  }
+
+  // program::select() over batches of views against run(), per event
+  void batches()
+  {
+    fmt::print("Batches, with the {0} kernel:\n", lspredicate::lanes_kernel());
+    auto events = lsprobeEvents();
+    for (const auto& expression : expressions)
+    {
+      fmt::print("{0}:\n", expression);
+      lsp::predicate::CmdlExpression predicate(expression);
+      evaluate("run() per event", predicate, events);
+      for (size_t size : {1, 8, 64, 256, 1024})
+      {
+	std::vector<std::vector<lsp::FileEventView>> batches;
+	for (size_t at = 0; at + size <= events.size(); at += size)
+	  batches.emplace_back(events.begin() + at, events.begin() + at + size);
+	std::vector<uint64_t> bits(lspredicate::lane_words(size));
+
+	size_t i = 0;
+	bench::perCall(fmt::format("select() per batch of {0}", size), batches.size() * rounds, [&]
+	    {
+	      predicate.select(batches[i], bits.data());
+	      bench::keep(bits);
+	      i = (i + 1 == batches.size() ? 0 : i + 1);
+	    }
+	    , size);
+      }
+    }
+  }
+
+  // every event type reads its fields through its own event_traits
+  void perType()
+  {
+    auto views = lsprobeEvents();
+    auto lsprobe = lsprobeOwned(views);
+    auto fanotify = fanotifyOwned(views);
+    for (const auto& expression : expressions)
+    {
+      fmt::print("{0}:\n", expression);
+      lsp::predicate::CmdlExpression predicate(expression);
+      Visited visited{predicate._expr};
+      evaluate("lsp::FileEventView, program", predicate, views);
+      evaluate("lsp::FileEventView, AST visitor", visited, views);
+      evaluate("std::unique_ptr<lsp::FileEvent>, program", predicate, lsprobe);
+      evaluate("std::unique_ptr<lsp::FileEvent>, AST visitor", visited, lsprobe);
+      evaluate("std::unique_ptr<fan::FileEvent>, program", predicate, fanotify);
+      evaluate("std::unique_ptr<fan::FileEvent>, AST visitor", visited, fanotify);
+    }
+  }
+}
+
+int main()
+{
+  spdlog::set_level(spdlog::level::warn);
+  compiled();
+  perType();
+  membership();
+  batches();
+}
@@ -0,0 +1,183 @@
+// Ingestion of two sources shaped like lsprobe and fanotify, from pipes fed
+// by writer threads: a reader thread per source (a blocking read() loop, and
+// poll() then read() for the fanotify one, as the readers do) against
+// lsp::UringIngest on the calling thread.
+#include "bench.h"
+#include "uring_ingest.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  constexpr size_t records = 1000000;
+  constexpr size_t fanRecord = 24; // sizeof(fanotify_event_metadata)
+  constexpr size_t bufferSize = 64 * 1024;
+
+  // a stream of records with a 4 byte length ahead, 32 to 160 bytes long,
+  // written in chunks that split them, as lsprobe reads may
+  std::vector<char> lspStream()
+  {
+    std::vector<char> all;
+    for (uint32_t i = 0; i < records; ++i)
+    {
+      uint32_t size = 32 + (i * 2654435761u) % 129;
+      size_t at = all.size();
+      all.resize(at + size);
+      std::memcpy(&all[at], &size, sizeof size);
+    }
+    return all;
+  }
+
+  void writeAll(int fd, const std::vector<char>& data, size_t chunk)
+  {
+    for (size_t at = 0; at < data.size();)
+    {
+      ssize_t n = ::write(fd, &data[at], std::min(chunk, data.size() - at));
+      if (n <= 0)
+	break;
+      at += n;
+    }
+    ::close(fd);
+  }
+
+  // the whole records in data, and the bytes they take
+  std::pair<size_t, size_t> parseLsp(const std::byte * data, size_t size)
+  {
+    size_t count = 0;
+    size_t at = 0;
+    while (size - at >= sizeof(uint32_t))
+    {
+      uint32_t record;
+      std::memcpy(&record, data + at, sizeof record);
+      if (record > size - at)
+	break;
+      at += record;
+      ++count;
+    }
+    return {count, at};
+  }
+
+  struct Feed
+  {
+    Feed()
+    {
+      if (::pipe2(lsp, O_CLOEXEC) == -1 || ::pipe2(fan, O_CLOEXEC) == -1)
+	throw std::runtime_error("pipe2 failed");
+      ::fcntl(lsp[1], F_SETPIPE_SZ, 1 << 20);
+      ::fcntl(fan[1], F_SETPIPE_SZ, 1 << 20);
+      static const std::vector<char> stream = lspStream();
+      static const std::vector<char> fanEvents(records * fanRecord);
+      lspWriter = std::thread(writeAll, lsp[1], std::cref(stream), 4093);
+      fanWriter = std::thread(writeAll, fan[1], std::cref(fanEvents), fanRecord * 170);
+    }
+
+    ~Feed()
+    {
+      lspWriter.join();
+      fanWriter.join();
+      ::close(lsp[0]);
+      ::close(fan[0]);
+    }
+
+    int lsp[2]{};
+    int fan[2]{};
+    std::thread lspWriter{};
+    std::thread fanWriter{};
+  };
+
+  void threads()
+  {
+    Feed feed;
+    std::atomic<size_t> syscalls{};
+    size_t lspEvents = 0;
+    size_t fanEvents = 0;
+    auto start = bench::clock::now();
+
+    std::thread lspReader([&]
+	{
+	  std::vector<std::byte> buffer(bufferSize);
+	  size_t carried = 0;
+	  ssize_t n;
+	  while ((n = ::read(feed.lsp[0], buffer.data() + carried, buffer.size() - carried)) > 0)
+	  {
+	    ++syscalls;
+	    auto [count, parsed] = parseLsp(buffer.data(), carried + n);
+	    lspEvents += count;
+	    carried = carried + n - parsed;
+	    std::memmove(buffer.data(), buffer.data() + parsed, carried);
+	  }
+	});
+    std::thread fanReader([&]
+	{
+	  std::vector<std::byte> buffer(bufferSize / fanRecord * fanRecord);
+	  pollfd fd{feed.fan[0], POLLIN, 0};
+	  for (;;)
+	  {
+	    ++syscalls;
+	    if (::poll(&fd, 1, 1000) <= 0)
+	      continue;
+	    ssize_t n = ::read(feed.fan[0], buffer.data(), buffer.size());
+	    ++syscalls;
+	    if (n <= 0)
+	      break;
+	    fanEvents += n / fanRecord;
+	  }
+	});
+    lspReader.join();
+    fanReader.join();
+
+    double elapsed = bench::seconds(start);
+    size_t events = lspEvents + fanEvents;
+    fmt::print("  {0:<24} {1:>10.0f} events/s {2:>8.1f} events/syscall ({3} events)\n"
+	, "thread per source", events / elapsed, double(events) / syscalls, events);
+  }
+
+  void uring(unsigned depth)
+  {
+    Feed feed;
+    size_t lspEvents = 0;
+    size_t fanEvents = 0;
+    auto start = bench::clock::now();
+
+    lsp::UringIngest ingest(depth);
+    ingest.add("lsprobe", feed.lsp[0], bufferSize
+	, [&lspEvents](const std::shared_ptr<lsp::Slab>& slab, size_t size)
+	{
+	  auto [count, parsed] = parseLsp(slab->data.data(), size);
+	  lspEvents += count;
+	  return parsed;
+	}
+	, true);
+    ingest.add("fanotify", feed.fan[0], bufferSize / fanRecord * fanRecord
+	, [&fanEvents](const std::shared_ptr<lsp::Slab>&, size_t size)
+	{
+	  fanEvents += size / fanRecord;
+	  return size;
+	});
+    ingest.run([]{return false;});
+
+    double elapsed = bench::seconds(start);
+    size_t events = lspEvents + fanEvents;
+    fmt::print("  {0:<24} {1:>10.0f} events/s {2:>8.1f} events/syscall ({3} events)\n"
+	, fmt::format("io_uring, depth {0}", depth), events / elapsed, double(events) / ingest._ring->_enters, events);
+  }
+}
+
+int main()
+{
+  fmt::print("{0} lsprobe and {0} fanotify records:\n", records);
+  threads();
+  if (!lsp::Uring::supported())
+  {
+    fmt::print("  io_uring is not supported here\n");
+    return 0;
+  }
+  for (unsigned depth : {1, 4, 16})
+    uring(depth);
+}
@@ -0,0 +1,104 @@
+#include "capture.h"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+uint64_t lsp::capture::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()
+      ).count();
+}
+
+lsp::CaptureWriter::CaptureWriter(const std::string& path, size_t flushSize)
+  : _path(path)
+  , _flushSize(flushSize)
+{
+  _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (_fd == -1)
+  {
+    std::error_code err(errno, std::system_category());
+    throw std::runtime_error(
+	fmt::format("Cannot open capture file '{0}': {1} - {2}", path, err.value(), err.message())
+	);
+  }
+
+  _buffer.reserve(_flushSize + LSP_EVENT_MAX_SIZE + sizeof(capture::RecordHeader));
+
+  struct stat st{};
+  if (::fstat(_fd, &st) == 0 && st.st_size == 0)
+  {
+    capture::FileHeader header{};
+    std::memcpy(header.magic, capture::magic, sizeof(header.magic));
+    header.version = capture::version;
+    auto bytes = reinterpret_cast<const std::byte *>(&header);
+    _buffer.insert(_buffer.end(), bytes, bytes + sizeof(header));
+  }
+  else if (st.st_size % capture::alignment)
+  {
+    throw std::runtime_error(
+	fmt::format("Capture file '{0}' is truncated, refusing to append", path)
+	);
+  }
+}
+
+lsp::CaptureWriter::~CaptureWriter()
+{
+  try
+  {
+    flush();
+  }
+  catch (const std::exception& e)
+  {
+    spdlog::error("{0}: {1}", __PRETTY_FUNCTION__, e.what());
+  }
+  if (_fd != -1)
+    ::close(_fd);
+  spdlog::debug("{0}: {1} records captured to '{2}'", __PRETTY_FUNCTION__, _records, _path);
+}
+
+void lsp::CaptureWriter::append(const lsp_event_t * event, size_t size, uint64_t timestamp)
+{
+  capture::RecordHeader header{timestamp, static_cast<uint32_t>(size), 0};
+  auto headerBytes = reinterpret_cast<const std::byte *>(&header);
+  auto eventBytes = reinterpret_cast<const std::byte *>(event);
+
+  _buffer.insert(_buffer.end(), headerBytes, headerBytes + sizeof(header));
+  _buffer.insert(_buffer.end(), eventBytes, eventBytes + size);
+  _buffer.resize(_buffer.size() + capture::padded(size) - size, std::byte{0});
+  ++_records;
+
+  if (_buffer.size() >= _flushSize)
+    flush();
+}
+
+void lsp::CaptureWriter::flush()
+{
+  size_t written = 0;
+  while (written < _buffer.size())
+  {
+    ssize_t bytes = ::write(_fd, _buffer.data() + written, _buffer.size() - written);
+    if (bytes == -1)
+    {
+      if (errno == EINTR)
+	continue;
+      std::error_code err(errno, std::system_category());
+      _buffer.clear();
+      throw std::runtime_error(
+	  fmt::format("Unable to write capture file '{0}': {1} - {2}", _path, err.value(), err.message())
+	  );
+    }
+    written += bytes;
+  }
+  _buffer.clear();
+}
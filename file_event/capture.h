@@ -0,0 +1,61 @@
+#pragma once
+
+#include "lsp_event.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace lsp
+{
+  // Capture file layout: a header followed by records, each one is a record
+  // header and the raw lsp_event_t padded up to the 8 bytes boundary, so that
+  // a mapped capture can be walked and viewed in place.
+  namespace capture
+  {
+    constexpr char magic[8] = {'L', 'S', 'P', 'C', 'A', 'P', 'T', 'R'};
+    constexpr uint32_t version = 1;
+    constexpr size_t alignment = 8;
+
+    struct FileHeader
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t reserved;
+    };
+
+    struct RecordHeader
+    {
+      uint64_t timestamp; // ingest time, ns since the epoch
+      uint32_t size;      // size of the lsp_event_t that follows
+      uint32_t reserved;
+    };
+
+    constexpr size_t padded(size_t size)
+    {
+      return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t now();
+  } // capture
+
+  struct CaptureWriter
+  {
+    explicit CaptureWriter(const std::string& path, size_t flushSize = 64 * 1024);
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    ~CaptureWriter();
+
+    void append(const lsp_event_t * event, size_t size, uint64_t timestamp);
+    void flush();
+
+    int _fd{-1};
+    std::string _path{};
+    size_t _flushSize{};
+    std::vector<std::byte> _buffer{};
+    size_t _records{};
+  };
+} // lsp
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lsp
+{
+  template<typename T> struct EventPool;
+
+  // returns the event to its pool instead of the heap
+  template<typename T>
+    struct PoolDeleter
+    {
+      void operator()(T * event) const {EventPool<T>::instance().release(event);}
+    };
+
+  template<typename T>
+    using pooled_ptr = std::unique_ptr<T, PoolDeleter<T>>;
+
+  // Recycles events of one type: a released event is kept constructed, so
+  // its strings keep their buffers and refilling it with assign() does not
+  // allocate when the new path fits. The reader acquires and the stages on
+  // other threads release, so every thread has a small cache of its own
+  // and moves events to and from the shared list in halves of it. The
+  // shared list is bounded, events beyond it go back to the heap.
+  template<typename T>
+    struct EventPool
+    {
+      static constexpr size_t cache_size = 64; // per thread
+
+      explicit EventPool(size_t capacity = 16384)
+	: _capacity(capacity)
+      {}
+
+      EventPool(const EventPool&) = delete;
+      EventPool& operator=(const EventPool&) = delete;
+
+      ~EventPool()
+      {
+	for (T * event : _free)
+	  delete event;
+      }
+
+      static EventPool& instance()
+      {
+	static EventPool pool;
+	return pool;
+      }
+
+      // a recycled event still holds its previous content, assign() it
+      pooled_ptr<T> acquire()
+      {
+	std::vector<T *>& cache = _cache._events;
+	if (cache.empty())
+	{
+	  std::lock_guard<std::mutex> lock(_mutex);
+	  size_t count = std::min(_free.size(), cache_size / 2);
+	  cache.insert(cache.end(), _free.end() - count, _free.end());
+	  _free.resize(_free.size() - count);
+	}
+
+	_live.fetch_add(1, std::memory_order_relaxed);
+	if (cache.empty())
+	{
+	  _allocated.fetch_add(1, std::memory_order_relaxed);
+	  return pooled_ptr<T>(new T());
+	}
+	T * event = cache.back();
+	cache.pop_back();
+	_recycled.fetch_add(1, std::memory_order_relaxed);
+	_idle.fetch_sub(1, std::memory_order_relaxed);
+	return pooled_ptr<T>(event);
+      }
+
+      void release(T * event)
+      {
+	_live.fetch_sub(1, std::memory_order_relaxed);
+	_idle.fetch_add(1, std::memory_order_relaxed);
+	std::vector<T *>& cache = _cache._events;
+	cache.push_back(event);
+	if (cache.size() >= cache_size)
+	  give(cache, cache_size / 2);
+      }
+
+      // moves `count` events of a thread cache to the shared list
+      void give(std::vector<T *>& cache, size_t count)
+      {
+	size_t trimmed = 0;
+	{
+	  std::lock_guard<std::mutex> lock(_mutex);
+	  for (size_t i = 0; i < count; ++i)
+	  {
+	    T * event = cache.back();
+	    cache.pop_back();
+	    if (_free.size() < _capacity)
+	      _free.push_back(event);
+	    else
+	    {
+	      delete event;
+	      ++trimmed;
+	    }
+	  }
+	}
+	_idle.fetch_sub(trimmed, std::memory_order_relaxed);
+	_trimmed.fetch_add(trimmed, std::memory_order_relaxed);
+      }
+
+      std::map<std::string, size_t> stats(const std::string& name) const
+      {
+	return {
+	  {name + " events: in use", _live.load()}
+	  , {name + " events: pooled", _idle.load()}
+	  , {name + " events: recycled", _recycled.load()}
+	  , {name + " events: allocated", _allocated.load()}
+	  , {name + " events: freed", _trimmed.load()}
+	};
+      }
+
+      void report(const std::string& name) const
+      {
+	size_t recycled = _recycled.load();
+	size_t allocated = _allocated.load();
+	if (!recycled && !allocated)
+	  return;
+	spdlog::info("{0} event pool: {1} recycled, {2} allocated ({3:.1f}% from the heap), {4} pooled, {5} freed"
+	    , name
+	    , recycled
+	    , allocated
+	    , (recycled + allocated ? 100.0 * allocated / (recycled + allocated) : 0.0)
+	    , _idle.load()
+	    , _trimmed.load()
+	    );
+      }
+
+      // the thread cache goes to the shared list when its thread exits
+      struct Cache
+      {
+	~Cache()
+	{
+	  if (!_events.empty())
+	    EventPool::instance().give(_events, _events.size());
+	}
+
+	std::vector<T *> _events{};
+      };
+
+      static thread_local Cache _cache;
+
+      size_t _capacity{};
+      std::mutex _mutex{};
+      std::vector<T *> _free{};
+
+      std::atomic<size_t> _live{};      // acquired, not released yet
+      std::atomic<size_t> _idle{};      // released, kept for reuse
+      std::atomic<size_t> _recycled{};  // acquired from the pool
+      std::atomic<size_t> _allocated{}; // acquired from the heap
+      std::atomic<size_t> _trimmed{};   // released to the heap, the pool was full
+    };
+
+  template<typename T>
+    thread_local typename EventPool<T>::Cache EventPool<T>::_cache{};
+
+} // lsp
@@ -5,6 +5,7 @@
 #include "utility.h"
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -12,6 +13,8 @@
 #include <sys/fanotify.h>
 #include "lspredicate/ast.hpp"
 #include "lspredicate/cmdl_expression.h"
+#include "lspredicate/interner.hpp"
+#include "event_pool.h"
 
 namespace fan
 {
@@ -25,17 +28,19 @@ namespace fan
   struct FileEvent
   {
     FileEvent(const fanotify_event_metadata * fa)
-      : code(
-	  (fa->mask & FAN_OPEN ) ? EventCode::OPEN  :
-	  (fa->mask & FAN_CLOSE) ? EventCode::CLOSE :
-	  EventCode::NONE
-	  )
+      : FileEvent(fa, linux::getFdPath(fa->fd))
+    {}
+
+    FileEvent(const fanotify_event_metadata * fa, std::string&& path)
+      : code(codeOf(fa->mask))
       , pid(fa->pid)
       , uid(-1)
-      , gid(getpgid(fa->pid))
-      , filename(linux::getFdPath(fa->fd))
-      , process(linux::getPidComm(fa->pid))
-    {}
+      , filename(std::move(path))
+      , filenameSymbol(lspredicate::interner::instance().intern(filename))
+    {
+      gid = linux::getPidInfo(fa->pid, process);
+      processSymbol = lspredicate::interner::instance().intern(process);
+    }
 
     FileEvent() = default;
     FileEvent(FileEvent&&) = default;
@@ -44,8 +49,28 @@ namespace fan
     FileEvent& operator=(const FileEvent&) = default;
     ~FileEvent() = default;
 
+    // refills a pooled event, the strings keep their buffers
+    void assign(const fanotify_event_metadata * fa, std::string_view path)
+    {
+      code = codeOf(fa->mask);
+      pid = fa->pid;
+      uid = -1;
+      gid = linux::getPidInfo(fa->pid, process);
+      filename.assign(path);
+      filenameSymbol = lspredicate::interner::instance().intern(filename);
+      processSymbol = lspredicate::interner::instance().intern(process);
+    }
+
+    static EventCode codeOf(uint64_t mask)
+    {
+      return (
+	  (mask & FAN_OPEN ) ? EventCode::OPEN  :
+	  (mask & FAN_CLOSE) ? EventCode::CLOSE :
+	  EventCode::NONE
+	  );
+    }
+
     std::string stringify() const;
-    bool evaluate(lspredicate::ast::expression const& ast) const;
 
     EventCode code{};
     pid_t pid{};
@@ -53,6 +78,8 @@ namespace fan
     gid_t gid{};
     std::string filename{};
     std::string process{};
+    lspredicate::symbol_t filenameSymbol{}; // see lspredicate::interner
+    lspredicate::symbol_t processSymbol{};
   };
 
 } // lsp
@@ -61,7 +88,26 @@ namespace lsp
 {
   namespace predicate
   {
+    // fanotify events, owned or pooled
+    template<typename Event>
+      struct fanotify_traits
+      {
+	using event_t = Event;
+
+	static long code(const event_t& event) {return static_cast<long>(event->code);}
+	static std::string_view filename(const event_t& event) {return event->filename;}
+	static std::string_view process(const event_t& event) {return event->process;}
+	static long pid(const event_t& event) {return event->pid;}
+	static long uid(const event_t& event) {return event->uid;}
+	static long gid(const event_t& event) {return event->gid;}
+	static lspredicate::symbol_t filename_symbol(const event_t& event) {return event->filenameSymbol;}
+	static lspredicate::symbol_t process_symbol(const event_t& event) {return event->processSymbol;}
+      };
+
+    template<>
+      struct event_traits<std::unique_ptr<fan::FileEvent>> : fanotify_traits<std::unique_ptr<fan::FileEvent>> {};
+
     template<>
-    bool evaluate<std::unique_ptr<fan::FileEvent>>(const std::unique_ptr<fan::FileEvent>& event, lspredicate::ast::expression const& ast);
+      struct event_traits<lsp::pooled_ptr<fan::FileEvent>> : fanotify_traits<lsp::pooled_ptr<fan::FileEvent>> {};
   }
 }
@@ -0,0 +1,163 @@
+#include "fanotify_handles.h"
+#include "utility.h"
+
+#include "spdlog/spdlog.h"
+#include "fmt/format.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+fan::HandleCache::HandleCache(size_t capacity)
+  : _capacity(capacity)
+{}
+
+fan::HandleCache::HandleCache(HandleCache&& other)
+  : _capacity(other._capacity)
+  , _mountFd(std::exchange(other._mountFd, -1))
+  , _paths(std::move(other._paths))
+  , _hits(other._hits)
+  , _misses(other._misses)
+  , _stale(other._stale)
+{}
+
+fan::HandleCache& fan::HandleCache::operator=(HandleCache&& other)
+{
+  if (this != &other)
+  {
+    close();
+    _capacity = other._capacity;
+    _mountFd = std::exchange(other._mountFd, -1);
+    _paths = std::move(other._paths);
+    _hits = other._hits;
+    _misses = other._misses;
+    _stale = other._stale;
+  }
+  return *this;
+}
+
+fan::HandleCache::~HandleCache()
+{
+  close();
+}
+
+void fan::HandleCache::open(const std::string& mountPath)
+{
+  close();
+  _mountFd = ::open(mountPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (_mountFd == -1)
+  {
+    std::error_code err(errno, std::system_category());
+    throw std::runtime_error(
+	fmt::format("Unable to open '{0}' for handle resolution: {1} - {2}", mountPath, err.value(), err.message())
+	);
+  }
+}
+
+void fan::HandleCache::close()
+{
+  if (_mountFd != -1)
+  {
+    spdlog::debug("{0}: {1} hits, {2} misses, {3} stale", __PRETTY_FUNCTION__, _hits, _misses, _stale);
+    ::close(_mountFd);
+    _mountFd = -1;
+  }
+  _paths.clear();
+}
+
+std::string fan::HandleCache::resolve(const fanotify_event_metadata * metadata)
+{
+#ifdef FAN_REPORT_FID
+  auto info = reinterpret_cast<const char *>(metadata) + metadata->metadata_len;
+  auto end = reinterpret_cast<const char *>(metadata) + metadata->event_len;
+  while (info + sizeof(fanotify_event_info_header) <= end)
+  {
+    auto header = reinterpret_cast<const fanotify_event_info_header *>(info);
+    if (header->len < sizeof(fanotify_event_info_header) || info + header->len > end)
+      break;
+
+    auto fid = reinterpret_cast<const fanotify_event_info_fid *>(info);
+    auto handle = reinterpret_cast<const struct file_handle *>(fid->handle);
+#ifdef FAN_EVENT_INFO_TYPE_DFID_NAME
+    if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+    {
+      const std::string * directory = lookup(&fid->fsid, handle);
+      if (!directory)
+	return {};
+
+      // the name follows the directory handle, '.' stands for the directory itself
+      const char * name = reinterpret_cast<const char *>(handle->f_handle) + handle->handle_bytes;
+      if (!std::strcmp(name, "."))
+	return *directory;
+      return (*directory == "/" ? "" : *directory) + "/" + name;
+    }
+#endif
+    if (header->info_type == FAN_EVENT_INFO_TYPE_FID)
+    {
+      const std::string * path = lookup(&fid->fsid, handle);
+      return (path ? *path : std::string{});
+    }
+    info += header->len;
+  }
+#else
+  (void)metadata;
+#endif
+  return {};
+}
+
+const std::string * fan::HandleCache::lookup(const void * fsid, const void * handle)
+{
+#ifdef FAN_REPORT_FID
+  auto fh = static_cast<const struct file_handle *>(handle);
+  std::string key;
+  key.reserve(sizeof(__kernel_fsid_t) + sizeof(struct file_handle) + fh->handle_bytes);
+  key.append(static_cast<const char *>(fsid), sizeof(__kernel_fsid_t));
+  key.append(static_cast<const char *>(handle), sizeof(struct file_handle) + fh->handle_bytes);
+
+  auto it = _paths.find(key);
+  if (it != _paths.end())
+  {
+    struct stat st{};
+    const Entry& entry = it->second;
+    if (::stat(entry.path.c_str(), &st) == 0 && st.st_ino == entry.ino && st.st_dev == entry.dev)
+    {
+      ++_hits;
+      return &entry.path;
+    }
+    ++_stale;
+    _paths.erase(it);
+  }
+  ++_misses;
+
+  // open_by_handle_at() wants a mutable handle
+  std::string copy(static_cast<const char *>(handle), sizeof(struct file_handle) + fh->handle_bytes);
+  int fd = ::open_by_handle_at(_mountFd, reinterpret_cast<struct file_handle *>(copy.data()), O_PATH | O_CLOEXEC);
+  if (fd == -1)
+  {
+    std::error_code err(errno, std::system_category());
+    spdlog::debug("{0}: unable to open a handle: {1} - {2}", __PRETTY_FUNCTION__, err.value(), err.message());
+    return nullptr;
+  }
+  Entry entry;
+  struct stat st{};
+  if (::fstat(fd, &st) == 0)
+  {
+    entry.dev = st.st_dev;
+    entry.ino = st.st_ino;
+  }
+  entry.path = linux::getFdPath(fd);
+  ::close(fd);
+
+  if (_paths.size() >= _capacity)
+    _paths.clear();
+  return &(_paths[std::move(key)] = std::move(entry)).path;
+#else
+  (void)fsid;
+  (void)handle;
+  return nullptr;
+#endif
+}
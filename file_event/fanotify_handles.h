@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+
+#include <sys/types.h>
+#include <sys/fanotify.h>
+
+namespace fan
+{
+  // Resolves file handles reported by fanotify in FID mode into paths.
+  // Directory handles are opened once with open_by_handle_at() and their
+  // paths are kept, so a file name reported next to a known directory
+  // costs a lookup, a stat() and a concatenation instead of an open and a
+  // readlink. The stat() revalidates the path: a mount mark does not report
+  // renames, so a path that no longer leads to the inode of the handle is
+  // resolved again.
+  struct HandleCache
+  {
+    struct Entry
+    {
+      std::string path{};
+      dev_t dev{};
+      ino_t ino{};
+    };
+
+    explicit HandleCache(size_t capacity = 65536);
+
+    HandleCache(const HandleCache&) = delete;
+    HandleCache& operator=(const HandleCache&) = delete;
+
+    HandleCache(HandleCache&&);
+    HandleCache& operator=(HandleCache&&);
+
+    ~HandleCache();
+
+    void open(const std::string& mountPath);
+    void close();
+
+    // an empty result means the event carried no usable handle
+    std::string resolve(const fanotify_event_metadata * metadata);
+
+    const std::string * lookup(const void * fsid, const void * handle);
+
+    size_t _capacity{};
+    int _mountFd{-1};
+    std::unordered_map<std::string, Entry> _paths{};
+
+    size_t _hits{};
+    size_t _misses{};
+    size_t _stale{}; // cached paths that led elsewhere
+  };
+} // fan
@@ -0,0 +1,142 @@
+#include "fanotify_pushdown.h"
+
+#include "spdlog/spdlog.h"
+
+#include <boost/variant/apply_visitor.hpp>
+#include <vector>
+
+namespace
+{
+  // Walks the predicate with negations pushed down to the comparisons,
+  // so `!(a || b)` is analysed as `!a && !b`.
+  struct PushdownAnalyzer
+  {
+    using result_type = fan::Pushdown;
+
+    bool _negated{};
+    size_t& _comparisons;
+    size_t& _pushed;
+
+    fan::Pushdown operator()(bool ast) const
+    {
+      return ((ast != _negated) ? fan::Pushdown::all() : fan::Pushdown::none());
+    }
+
+    fan::Pushdown operator()(lspredicate::ast::negated const& ast) const
+    {
+      PushdownAnalyzer analyzer{_negated != (ast.sign == '!'), _comparisons, _pushed};
+      return boost::apply_visitor(analyzer, ast.operand_);
+    }
+
+    fan::Pushdown operator()(lspredicate::ast::comparison const& ast) const
+    {
+      ++_comparisons;
+      auto op = ast.operation_.operator_;
+      // files and process attributes are left to userspace
+      if (ast.identifier != lspredicate::ast::comparison_identifier::EVENT
+	  || (op != lspredicate::ast::comparison_operator::EQ
+	    && op != lspredicate::ast::comparison_operator::NEQ
+	    && op != lspredicate::ast::comparison_operator::IN))
+	return fan::Pushdown::all();
+
+      // `in` takes inline lists only, a set file is left to userspace
+      std::vector<long> codes;
+      const auto& operand = ast.operation_.operand_;
+      if (auto code = boost::get<long>(&operand))
+	codes.push_back(*code);
+      else if (auto list = boost::get<std::vector<long>>(&operand))
+	codes = *list;
+      if (codes.empty())
+	return fan::Pushdown::all();
+
+      // event codes are the fanotify masks, see fan::EventCode
+      uint64_t mask = 0;
+      for (long code : codes)
+	mask |=
+	  (code == FAN_OPEN ) ? FAN_OPEN :
+	  (code == FAN_CLOSE) ? FAN_CLOSE_WRITE :
+	  0;
+      bool equal = ((op != lspredicate::ast::comparison_operator::NEQ) != _negated);
+      fan::Pushdown result;
+      result._mask = (equal ? mask : (fan::Pushdown::allEvents & ~mask));
+      ++_pushed;
+      return result;
+    }
+
+    fan::Pushdown operator()(lspredicate::ast::disjunctive_expression const& ast) const
+    {
+      fan::Pushdown result = boost::apply_visitor(*this, ast.head);
+      for (const auto& operation : ast.tail)
+      {
+	fan::Pushdown next = boost::apply_visitor(*this, operation.operand_);
+	result = (_negated
+	    ? fan::Pushdown::both(std::move(result), std::move(next))
+	    : fan::Pushdown::either(std::move(result), std::move(next))
+	    );
+      }
+      return result;
+    }
+
+    fan::Pushdown operator()(lspredicate::ast::conjunctive_expression const& ast) const
+    {
+      fan::Pushdown result = boost::apply_visitor(*this, ast.head);
+      for (const auto& operation : ast.tail)
+      {
+	fan::Pushdown next = boost::apply_visitor(*this, operation.operand_);
+	result = (_negated
+	    ? fan::Pushdown::either(std::move(result), std::move(next))
+	    : fan::Pushdown::both(std::move(result), std::move(next))
+	    );
+      }
+      return result;
+    }
+  };
+}
+
+fan::Pushdown fan::Pushdown::analyze(const lspredicate::ast::expression& ast)
+{
+  size_t comparisons = 0;
+  size_t pushed = 0;
+  Pushdown result = PushdownAnalyzer{false, comparisons, pushed}(ast);
+  result._comparisons = comparisons;
+  result._pushed = pushed;
+  return result;
+}
+
+fan::Pushdown fan::Pushdown::all()
+{
+  return Pushdown{};
+}
+
+fan::Pushdown fan::Pushdown::none()
+{
+  Pushdown result;
+  result._mask = 0;
+  return result;
+}
+
+fan::Pushdown fan::Pushdown::both(Pushdown&& lhs, Pushdown&& rhs)
+{
+  if (!lhs._mask || !rhs._mask)
+    return none();
+
+  Pushdown result;
+  result._mask = lhs._mask & rhs._mask;
+  return result;
+}
+
+fan::Pushdown fan::Pushdown::either(Pushdown&& lhs, Pushdown&& rhs)
+{
+  Pushdown result;
+  result._mask = lhs._mask | rhs._mask;
+  return result;
+}
+
+void fan::Pushdown::report() const
+{
+  spdlog::info("fanotify pushdown: {0} of {1} comparisons, mask {2:#x}"
+      , _pushed
+      , _comparisons
+      , _mask
+      );
+}
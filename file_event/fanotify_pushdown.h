@@ -0,0 +1,35 @@
+#pragma once
+
+#include "lspredicate/ast.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/fanotify.h>
+
+namespace fan
+{
+  // The part of a predicate fanotify can enforce itself: every event the
+  // predicate accepts has a type in _mask. It is only a prefilter, the
+  // predicate still runs in userspace on whatever gets through. File
+  // comparisons are not pushed down: marks follow inodes, not paths, so a
+  // rename or a hard link would make them drop events the predicate accepts.
+  struct Pushdown
+  {
+    static constexpr uint64_t allEvents = FAN_OPEN | FAN_CLOSE_WRITE;
+
+    uint64_t _mask{allEvents};
+
+    size_t _comparisons{}; // in the whole predicate
+    size_t _pushed{};      // of them enforced by the kernel
+
+    static Pushdown analyze(const lspredicate::ast::expression&);
+
+    static Pushdown all();
+    static Pushdown none();
+    static Pushdown both(Pushdown&&, Pushdown&&);
+    static Pushdown either(Pushdown&&, Pushdown&&);
+
+    void report() const;
+  };
+} // fan
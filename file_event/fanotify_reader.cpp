@@ -5,17 +5,28 @@
 
 std::atomic_bool fan::Reader::stopping{};
 
+fan::Reader::Reader(Mode mode)
+  : _mode(mode)
+{}
+
 fan::Reader::~Reader()
 {
   if (_fad > 0)
     close(_fad);
 }
 
-void fan::Reader::operator()(stlab::sender<event_t>&& send, std::string&& path)
+void fan::Reader::open(const std::string& path, unsigned flags)
 {
-  _send = std::move(send);
+  if (_mode == Mode::FID)
+  {
+    if (openFid(path, flags))
+      return;
+    spdlog::info("fanotify FID reporting is not supported here, falling back to file descriptors...");
+    _mode = Mode::FD;
+  }
+
   std::error_code err{};
-  _fad = fanotify_init(FAN_CLOEXEC | FAN_CLASS_CONTENT | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE);
+  _fad = fanotify_init(FAN_CLOEXEC | FAN_CLASS_CONTENT | flags, O_RDONLY | O_LARGEFILE);
   if (_fad == -1)
   {
     err.assign(errno, std::system_category());
@@ -24,14 +35,102 @@ void fan::Reader::operator()(stlab::sender<event_t>&& send, std::string&& path)
 	);
 
   }
-  spdlog::debug("{0}: marking '{1}'", __PRETTY_FUNCTION__, path);
-  if (fanotify_mark(_fad, FAN_MARK_ADD | FAN_MARK_MOUNT, FAN_OPEN | FAN_CLOSE_WRITE, AT_FDCWD, path.c_str()) == -1)
+  err = mark(path);
+  if (err)
   {
-    err.assign(errno, std::system_category());
     throw std::runtime_error(
 	fmt::format("Unable to mark the fanotify subscription to '{0}': {1} - {2}", path, err.value(), err.message())
 	);
   }
+}
+
+// FID groups cannot be of the content class, which is only needed for
+// permission events anyway. Returns false when the kernel or the marked
+// filesystem does not support FID reporting.
+bool fan::Reader::openFid(const std::string& path, unsigned flags)
+{
+#ifdef FAN_REPORT_FID
+  std::error_code err{};
+  for (unsigned report :
+      {
+#ifdef FAN_REPORT_DFID_NAME
+	static_cast<unsigned>(FAN_REPORT_DFID_NAME),
+#endif
+	static_cast<unsigned>(FAN_REPORT_FID)
+      })
+  {
+    _fad = fanotify_init(FAN_CLOEXEC | FAN_CLASS_NOTIF | report | flags, O_RDONLY | O_LARGEFILE);
+    if (_fad == -1)
+    {
+      if (errno == EINVAL)
+	continue;
+      err.assign(errno, std::system_category());
+      throw std::runtime_error(
+	  fmt::format("Unable to init the fanotify facility: {0} - {1}", err.value(), err.message())
+	  );
+    }
+
+    spdlog::debug("{0}: reporting {1:#x}", __PRETTY_FUNCTION__, report);
+    err = mark(path);
+    if (err)
+    {
+      close(_fad);
+      _fad = 0;
+      if (err.value() == EINVAL || err.value() == ENODEV || err.value() == EXDEV || err.value() == EOPNOTSUPP)
+	continue;
+      throw std::runtime_error(
+	  fmt::format("Unable to mark the fanotify subscription to '{0}': {1} - {2}", path, err.value(), err.message())
+	  );
+    }
+
+    _handles.open(path);
+    return true;
+  }
+#else
+  (void)path;
+  (void)flags;
+#endif
+  return false;
+}
+
+// Marks the mount of the path. Events of the types the predicate rejects are
+// left out of the mask, so the kernel drops them before they are queued.
+std::error_code fan::Reader::mark(const std::string& path)
+{
+  std::error_code err{};
+  if (!_pushdown._mask)
+  {
+    spdlog::warn("{0}: the predicate rejects every fanotify event, nothing is marked", __PRETTY_FUNCTION__);
+    return err;
+  }
+
+  spdlog::debug("{0}: marking '{1}' with {2:#x}", __PRETTY_FUNCTION__, path, _pushdown._mask);
+  if (fanotify_mark(_fad, FAN_MARK_ADD | FAN_MARK_MOUNT, _pushdown._mask, AT_FDCWD, path.c_str()) == -1)
+  {
+    err.assign(errno, std::system_category());
+    return err;
+  }
+  return err;
+}
+
+void fan::Reader::pushdown(const lsp::predicate::CmdlExpression& predicate)
+{
+  if (predicate.empty())
+    return;
+  _pushdown = Pushdown::analyze(predicate._expr);
+  _pushdown.report();
+}
+
+// info records with handles and names make FID events larger
+size_t fan::Reader::bufferSize() const
+{
+  return (_mode == Mode::FID ? 4096 : 128) * sizeof(struct fanotify_event_metadata);
+}
+
+void fan::Reader::operator()(lsp::Sender<batch_t>&& send, std::string&& path)
+{
+  _send = std::move(send);
+  open(path, FAN_NONBLOCK);
 
   pollEvents(_fad);
   close(_fad);
@@ -66,36 +165,12 @@ void fan::Reader::pollEvents(int fad)
 void fan::Reader::handleEvents(int fad)
 {
   using metadata_t = struct fanotify_event_metadata;
-  std::vector<metadata_t> metadataBuffer(128);
+  std::vector<metadata_t> metadataBuffer(bufferSize() / sizeof(metadata_t));
 
   auto bytesRead = read(fad, reinterpret_cast<char *>(metadataBuffer.data()), sizeof(metadata_t) * metadataBuffer.size());
   while (!stopping.load() && bytesRead > 0)
   {
-    auto metadata = &metadataBuffer[0];
-    while (FAN_EVENT_OK(metadata, bytesRead))
-    {
-      if (metadata->vers != FANOTIFY_METADATA_VERSION)
-      {
-	throw std::runtime_error(
-	    fmt::format(
-	      "fanotify metadata version mismatch: {0} vs {1} expected."
-	      , metadata->vers
-	      , FANOTIFY_METADATA_VERSION
-	      )
-	    );
-      }
-      if (metadata->fd >= 0)
-      {
-	if (!stopping.load())
-	  _send(std::make_unique<FileEvent>(metadata));
-	close(metadata->fd);
-      }
-      else if (metadata->fd == FAN_NOFD)
-      {
-	spdlog::warn("{0}: event buffer overflow", __PRETTY_FUNCTION__);
-      }
-      metadata = FAN_EVENT_NEXT(metadata, bytesRead);
-    }
+    parseEvents(reinterpret_cast<std::byte *>(metadataBuffer.data()), bytesRead);
 
     if (!stopping.load())
       bytesRead = read(fad, reinterpret_cast<char *>(metadataBuffer.data()), sizeof(metadata_t) * metadataBuffer.size());
@@ -107,6 +182,52 @@ void fan::Reader::handleEvents(int fad)
   }
 }
 
+void fan::Reader::parseEvents(std::byte * data, ssize_t bytesRead)
+{
+  using metadata_t = struct fanotify_event_metadata;
+  auto metadata = reinterpret_cast<metadata_t *>(data);
+  auto& pool = lsp::EventPool<FileEvent>::instance();
+  batch_t batch;
+  while (FAN_EVENT_OK(metadata, bytesRead))
+  {
+    if (metadata->vers != FANOTIFY_METADATA_VERSION)
+    {
+      throw std::runtime_error(
+	  fmt::format(
+	    "fanotify metadata version mismatch: {0} vs {1} expected."
+	    , metadata->vers
+	    , FANOTIFY_METADATA_VERSION
+	    )
+	  );
+    }
+    if (metadata->mask & FAN_Q_OVERFLOW)
+    {
+      spdlog::warn("{0}: event buffer overflow", __PRETTY_FUNCTION__);
+    }
+    else if (_mode == Mode::FID)
+    {
+      std::string filename = _handles.resolve(metadata);
+      if (!stopping.load() && !filename.empty())
+      {
+	batch.push_back(pool.acquire());
+	batch.back()->assign(metadata, filename);
+      }
+    }
+    else if (metadata->fd >= 0)
+    {
+      if (!stopping.load())
+      {
+	batch.push_back(pool.acquire());
+	batch.back()->assign(metadata, linux::readFdPath(metadata->fd));
+      }
+      close(metadata->fd);
+    }
+    metadata = FAN_EVENT_NEXT(metadata, bytesRead);
+  }
+  if (!batch.empty())
+    _send(std::move(batch));
+}
+
 // ---------------------------------------------------------------------------
 
 // std::atomic_bool fan::v2::Reader::stopping{};
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "fanotify_event.h"
+#include "fanotify_handles.h"
+#include "fanotify_pushdown.h"
+#include "lspredicate/cmdl_expression.h"
 
 #include <memory>
 #include <cstddef>
 #include <atomic>
-#include "stlab/concurrency/channel.hpp"
+#include <string>
+#include <vector>
+#include <system_error>
+#include "sender.h"
 
 #include <sys/types.h>
 #include <sys/fanotify.h>
@@ -14,9 +20,19 @@ namespace fan
 {
   struct Reader
   {
-    using event_t = std::unique_ptr<fan::FileEvent>;
+    using event_t = lsp::pooled_ptr<fan::FileEvent>; // see lsp::EventPool
+    using batch_t = std::vector<event_t>; // the events of one read
+
+    // FD: the kernel opens every reported file, the path is read back from the fd
+    // FID: the kernel reports file handles, paths come from the handle cache
+    enum class Mode
+    {
+      FD
+      , FID
+    };
 
     Reader() = default;
+    explicit Reader(Mode mode);
 
     Reader(const Reader&) = delete;
     Reader& operator=(const Reader&) = delete;
@@ -26,13 +42,22 @@ namespace fan
 
     ~Reader();
 
+    void open(const std::string& path, unsigned flags);
+    bool openFid(const std::string& path, unsigned flags);
+    std::error_code mark(const std::string& path);
+    void pushdown(const lsp::predicate::CmdlExpression& predicate);
+    size_t bufferSize() const;
     void handleEvents(int fad);
     void pollEvents(int fad);
+    void parseEvents(std::byte * data, ssize_t size);
 
-    void operator()(stlab::sender<event_t>&& send, std::string&& path);
+    void operator()(lsp::Sender<batch_t>&& send, std::string&& path);
 
     int _fad{};
-    stlab::sender<event_t> _send;
+    Mode _mode{Mode::FD};
+    HandleCache _handles{};
+    Pushdown _pushdown{};
+    lsp::Sender<batch_t> _send;
 
     static std::atomic_bool stopping;
   };
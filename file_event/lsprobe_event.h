@@ -6,26 +6,104 @@
 #include "spdlog/spdlog.h"
 
 #include <string>
+#include <string_view>
+#include <cstring>
 #include <vector>
 #include <memory>
 
 #include <sys/types.h>
 #include "lspredicate/ast.hpp"
 #include "lspredicate/cmdl_expression.h"
+#include "lspredicate/interner.hpp"
+#include "event_pool.h"
 
 namespace lsp
 {
+  // Full size of the record, i.e. the header plus all of its fields
+  inline size_t eventSize(const lsp_event_t * event)
+  {
+    return event->size;
+  }
+
+  // Text of a field up to its terminating zero, but not past the end of the
+  // record: the field values are not sized, so a missing zero is cut there
+  inline std::string_view fieldText(const lsp_event_t * event, const lsp_event_field_t * field)
+  {
+    const char * end = reinterpret_cast<const char *>(event) + eventSize(event);
+    const char * value = field->value;
+    return (value < end ? std::string_view(value, ::strnlen(value, end - value)) : std::string_view{});
+  }
+
+  // Non-owning event: the filename and the process point into the raw record
+  // which is kept alive by the owner (a slab, a mapped capture, etc.)
+  struct FileEventView
+  {
+    FileEventView(std::shared_ptr<const void> owner, const lsp_event_t * event)
+      : code(static_cast<lsp_event_code_t>(event->code))
+      , pcred(event->pcred)
+      , filename(fieldText(event, lsp_event_field_first_const(event)))
+      , process(fieldText(event, lsp_event_field_get_const(event, 1)))
+      , filenameSymbol(lspredicate::interner::instance().intern(filename))
+      , processSymbol(lspredicate::interner::instance().intern(process))
+      , _owner(std::move(owner))
+    {}
+
+    FileEventView(
+	std::shared_ptr<const void> owner
+	, lsp_event_code_t code
+	, const lsp_cred_t& pcred
+	, std::string_view filename
+	, std::string_view process
+	)
+      : code(code)
+      , pcred(pcred)
+      , filename(filename)
+      , process(process)
+      , filenameSymbol(lspredicate::interner::instance().intern(filename))
+      , processSymbol(lspredicate::interner::instance().intern(process))
+      , _owner(std::move(owner))
+    {}
+
+    FileEventView() = default;
+    FileEventView(FileEventView&&) = default;
+    FileEventView(const FileEventView&) = default;
+    FileEventView& operator=(FileEventView&&) = default;
+    FileEventView& operator=(const FileEventView&) = default;
+    ~FileEventView() = default;
+
+    // lets the view be used where the stages expect an event pointer
+    const FileEventView * operator->() const {return this;}
+
+    std::string stringify() const;
+
+    lsp_event_code_t code{};
+    lsp_cred_t pcred{};
+    std::string_view filename{};
+    std::string_view process{};
+    lspredicate::symbol_t filenameSymbol{}; // see lspredicate::interner
+    lspredicate::symbol_t processSymbol{};
+
+    std::shared_ptr<const void> _owner{};
+  };
+
   struct FileEvent
   {
     FileEvent(const lsp_event_t * event)
       : code(static_cast<lsp_event_code_t>(event->code))
       , pcred(event->pcred)
-      , filename(
-	  lsp_event_field_first_const(event)->value
-	  )
-      , process(
-	  lsp_event_field_get_const(event, 1)->value
-	  )
+      , filename(fieldText(event, lsp_event_field_first_const(event)))
+      , process(fieldText(event, lsp_event_field_get_const(event, 1)))
+      , filenameSymbol(lspredicate::interner::instance().intern(filename))
+      , processSymbol(lspredicate::interner::instance().intern(process))
+    {}
+
+    explicit FileEvent(const FileEventView& view)
+      : code(view.code)
+      , pcred(view.pcred)
+      , filename(view.filename)
+      , process(view.process)
+      , filenameSymbol(view.filenameSymbol)
+      , processSymbol(view.processSymbol)
     {}
 
     FileEvent() = default;
@@ -35,17 +113,58 @@ namespace lsp
     FileEvent& operator=(const FileEvent&) = default;
     ~FileEvent() = default;
 
+    // refills a pooled event, the strings keep their buffers
+    void assign(const FileEventView& view)
+    {
+      code = view.code;
+      pcred = view.pcred;
+      filename.assign(view.filename);
+      process.assign(view.process);
+      filenameSymbol = view.filenameSymbol;
+      processSymbol = view.processSymbol;
+    }
+
     std::string stringify() const;
 
     lsp_event_code_t code{};
     lsp_cred_t pcred{};
     std::string filename{};
     std::string process{};
+    lspredicate::symbol_t filenameSymbol{};
+    lspredicate::symbol_t processSymbol{};
   };
 
+  // an owning copy of a view, from the event pool
+  inline pooled_ptr<FileEvent> pooled(const FileEventView& view)
+  {
+    auto event = EventPool<FileEvent>::instance().acquire();
+    event->assign(view);
+    return event;
+  }
+
   namespace predicate
   {
+    // lsprobe events, owning or not, carry the credentials of the process
+    template<typename Event>
+      struct lsprobe_traits
+      {
+	static long code(const Event& event) {return static_cast<long>(event->code);}
+	static std::string_view filename(const Event& event) {return event->filename;}
+	static std::string_view process(const Event& event) {return event->process;}
+	static long pid(const Event& event) {return event->pcred.tgid;}
+	static long uid(const Event& event) {return event->pcred.uid;}
+	static long gid(const Event& event) {return event->pcred.gid;}
+	static lspredicate::symbol_t filename_symbol(const Event& event) {return event->filenameSymbol;}
+	static lspredicate::symbol_t process_symbol(const Event& event) {return event->processSymbol;}
+      };
+
+    template<>
+      struct event_traits<std::unique_ptr<FileEvent>> : lsprobe_traits<std::unique_ptr<FileEvent>> {};
+
+    template<>
+      struct event_traits<pooled_ptr<FileEvent>> : lsprobe_traits<pooled_ptr<FileEvent>> {};
+
     template<>
-    bool evaluate<std::unique_ptr<FileEvent>>(const std::unique_ptr<FileEvent>& event, lspredicate::ast::expression const& ast);
+      struct event_traits<FileEventView> : lsprobe_traits<FileEventView> {};
   }
 }
@@ -9,18 +9,28 @@
 #include <errno.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 
 std::atomic_bool lsp::Reader::stopping{};
 
+lsp::Reader::Reader(size_t batch)
+  : _batch(std::max<size_t>(batch, 1))
+{}
+
 lsp::Reader::~Reader()
 {
   if (_fd > 0)
     close(_fd);
 }
 
-void lsp::Reader::operator()(stlab::sender<event_t>&& _send)
+void lsp::Reader::capture(const std::string& path)
+{
+  _capture = std::make_shared<CaptureWriter>(path);
+}
+
+void lsp::Reader::open()
 {
-  _fd = open("/sys/kernel/security/lsprobe/events", O_RDONLY);
+  _fd = ::open("/sys/kernel/security/lsprobe/events", O_RDONLY);
   if (_fd == -1)
   {
     std::error_code err(errno, std::system_category());
@@ -28,22 +38,105 @@ void lsp::Reader::operator()(stlab::sender<event_t>&& _send)
 	fmt::format("Cannot open '/sys/kernel/security/lsprobe/events': {0} - {1}", err.value(), err.message())
 	);
   }
+}
+
+size_t lsp::Reader::parseEvents(const std::shared_ptr<Slab>& slab, size_t size, batch_t& batch) const
+{
+  const std::byte * data = slab->data.data();
+  const uint64_t timestamp = (_capture ? capture::now() : 0);
+  size_t offset = 0;
+  while (size - offset >= sizeof(lsp_event_t))
+  {
+    auto event = reinterpret_cast<const lsp_event_t *>(data + offset);
+    size_t eventSize = lsp::eventSize(event);
+    if (eventSize < sizeof(lsp_event_t) || eventSize > LSP_EVENT_MAX_SIZE)
+    {
+      throw std::runtime_error(
+	  fmt::format("Malformed lsprobe record at offset {0}: size {1}", offset, eventSize)
+	  );
+    }
+    if (eventSize > size - offset)
+      break; // the rest of the record comes with the next read
+
+    batch.emplace_back(slab, event);
+    if (_capture)
+      _capture->append(event, eventSize, timestamp);
+    offset += eventSize;
+  }
+  return offset;
+}
+
+// Completion of a read issued elsewhere (e.g. by lsp::UringIngest), which
+// keeps the reads in order: returns the bytes parsed, the rest is the head
+// of a record the caller puts ahead of the next read.
+size_t lsp::Reader::handleRead(const std::shared_ptr<Slab>& slab, size_t size, lsp::Sender<batch_t>& send)
+{
+  ++_reads;
+  batch_t batch;
+  batch.reserve(_batch);
+  size_t parsed = parseEvents(slab, size, batch);
 
-  std::vector<std::byte> _buffer(LSP_EVENT_MAX_SIZE);
-  lsp_event_t * event = new(_buffer.data()) lsp_event_t;
+  _events += batch.size();
+  if (!batch.empty())
+    send(std::move(batch));
+  return parsed;
+}
+
+void lsp::Reader::report() const
+{
+  spdlog::info("lsprobe: {0} events in {1} reads ({2:.2f} events per syscall)"
+      , _events
+      , _reads
+      , (_reads ? static_cast<double>(_events) / _reads : 0.0)
+      );
+}
+
+void lsp::Reader::operator()(lsp::Sender<batch_t>&& _send)
+{
+  open();
+
+  // Events of a batch refer to the slab they were read into, so every read
+  // goes to a fresh slab from the pool. The tail of a record split between
+  // two reads is moved to the next slab and completed by the next read.
+  SlabPool slabs(_batch * LSP_EVENT_MAX_SIZE);
+  auto slab = slabs.acquire();
+  size_t pending = 0;
 
-  ssize_t bytesRead = ::read(_fd, event, LSP_EVENT_MAX_SIZE);
+  ssize_t bytesRead = ::read(_fd, slab->data.data(), slab->data.size());
   while (!stopping.load() && bytesRead > 0)
   {
-    _send(std::make_unique<FileEvent>(event));
+    ++_reads;
+    size_t available = pending + bytesRead;
+
+    batch_t batch;
+    batch.reserve(_batch);
+    size_t parsed = parseEvents(slab, available, batch);
+
+    pending = available - parsed;
+    if (!batch.empty())
+    {
+      auto next = slabs.acquire();
+      if (pending)
+	std::memcpy(next->data.data(), slab->data.data() + parsed, pending);
+      slab = std::move(next);
+    }
+
+    _events += batch.size();
+    if (!batch.empty())
+      _send(std::move(batch));
+
     if (!stopping.load())
-      bytesRead = ::read(_fd, event, LSP_EVENT_MAX_SIZE);
+      bytesRead = ::read(_fd, slab->data.data() + pending, slab->data.size() - pending);
   }
 
   std::error_code err(errno, std::system_category());
   close(_fd);
   _fd = 0;
 
+  spdlog::debug("{0}: {1} slabs allocated", __PRETTY_FUNCTION__, slabs.allocated());
+
+  report();
+
   if (bytesRead < 0)
   {
     throw std::runtime_error(
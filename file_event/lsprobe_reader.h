@@ -2,19 +2,25 @@
 
 #include "lsp_event.h"
 #include "lsprobe_event.h"
+#include "slab_pool.h"
+#include "capture.h"
 
 #include <memory>
 #include <cstddef>
 #include <atomic>
-#include "stlab/concurrency/channel.hpp"
+#include <vector>
+#include <string>
+#include "sender.h"
 
 namespace lsp
 {
   struct Reader
   {
-    using event_t = std::unique_ptr<lsp::FileEvent>;
+    using event_t = lsp::FileEventView;
+    using batch_t = std::vector<event_t>;
 
     Reader() = default;
+    explicit Reader(size_t batch);
 
     Reader(const Reader&) = delete;
     Reader& operator=(const Reader&) = delete;
@@ -24,9 +30,20 @@ namespace lsp
 
     ~Reader();
 
-    void operator()(stlab::sender<event_t>&& send);
+    void capture(const std::string& path);
+    void open();
+    size_t parseEvents(const std::shared_ptr<Slab>& slab, size_t size, batch_t& batch) const;
+    size_t handleRead(const std::shared_ptr<Slab>& slab, size_t size, lsp::Sender<batch_t>& send);
+    void report() const;
+
+    void operator()(lsp::Sender<batch_t>&& send);
 
     int _fd{};
+    size_t _batch{1}; // max records pulled by a single read()
+    std::shared_ptr<CaptureWriter> _capture{}; // raw records are appended here if set
+
+    size_t _reads{};
+    size_t _events{};
 
     static std::atomic_bool stopping;
   };
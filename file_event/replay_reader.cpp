@@ -0,0 +1,179 @@
+#include "replay_reader.h"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+std::atomic_bool lsp::ReplayReader::stopping{};
+
+namespace
+{
+  // Whether the fields the events are viewed with start within the size
+  // bytes of the record. The first field is checked before the second is
+  // looked up, as finding it reads the size of the first.
+  bool fieldsWithin(const lsp_event_t * event, size_t size)
+  {
+    auto begin = reinterpret_cast<const char *>(event);
+    auto end = begin + size;
+    auto within = [begin, end](const lsp_event_field_t * field)
+      {
+	auto at = reinterpret_cast<const char *>(field);
+	return (at >= begin && at < end && size_t(end - at) > offsetof(lsp_event_field_t, value));
+      };
+    return within(lsp_event_field_first_const(event)) && within(lsp_event_field_get_const(event, 1));
+  }
+}
+
+lsp::ReplayReader::ReplayReader(std::string path, double speed, size_t batch)
+  : _path(std::move(path))
+  , _speed(std::max(speed, 0.0))
+  , _batch(std::max<size_t>(batch, 1))
+{}
+
+std::shared_ptr<const lsp::ReplayReader::Mapping> lsp::ReplayReader::map() const
+{
+  int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    std::error_code err(errno, std::system_category());
+    throw std::runtime_error(
+	fmt::format("Cannot open capture file '{0}': {1} - {2}", _path, err.value(), err.message())
+	);
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(capture::FileHeader))
+  {
+    ::close(fd);
+    throw std::runtime_error(fmt::format("'{0}' is not a capture file", _path));
+  }
+
+  size_t size = st.st_size;
+  void * data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  std::error_code err(errno, std::system_category());
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    throw std::runtime_error(
+	fmt::format("Cannot map capture file '{0}': {1} - {2}", _path, err.value(), err.message())
+	);
+  }
+  ::madvise(data, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  std::shared_ptr<const Mapping> mapping(
+      new Mapping{static_cast<const std::byte *>(data), size}
+      , [](const Mapping * m)
+	{
+	  ::munmap(const_cast<std::byte *>(m->data), m->size);
+	  delete m;
+	}
+      );
+
+  auto header = reinterpret_cast<const capture::FileHeader *>(mapping->data);
+  if (std::memcmp(header->magic, capture::magic, sizeof(header->magic)) != 0
+      || header->version != capture::version
+      )
+  {
+    throw std::runtime_error(fmt::format("'{0}' is not a capture file of version {1}", _path, capture::version));
+  }
+  return mapping;
+}
+
+void lsp::ReplayReader::operator()(lsp::Sender<batch_t>&& send)
+{
+  using clock = std::chrono::steady_clock;
+
+  auto mapping = map();
+  const std::byte * data = mapping->data;
+  size_t offset = sizeof(capture::FileHeader);
+
+  batch_t batch;
+  batch.reserve(_batch);
+
+  auto flush = [&batch, &send, this]
+    {
+      if (batch.empty())
+	return;
+      send(std::move(batch));
+      batch = batch_t{};
+      batch.reserve(_batch);
+    };
+
+  auto start = clock::now();
+  uint64_t firstTimestamp = 0;
+
+  while (!stopping.load() && offset + sizeof(capture::RecordHeader) <= mapping->size)
+  {
+    auto record = reinterpret_cast<const capture::RecordHeader *>(data + offset);
+    if (record->size < sizeof(lsp_event_t) || record->size > LSP_EVENT_MAX_SIZE)
+    {
+      throw std::runtime_error(
+	  fmt::format("Malformed record in '{0}' at offset {1}: size {2}", _path, offset, record->size)
+	  );
+    }
+    size_t next = offset + sizeof(capture::RecordHeader) + capture::padded(record->size);
+    if (next > mapping->size)
+    {
+      spdlog::warn("{0}: '{1}' is truncated at offset {2}, the record of {3} bytes ends past {4}"
+	  , __PRETTY_FUNCTION__, _path, offset, record->size, mapping->size);
+      break;
+    }
+
+    auto event = reinterpret_cast<const lsp_event_t *>(record + 1);
+    if (lsp::eventSize(event) != record->size)
+    {
+      throw std::runtime_error(
+	  fmt::format("Malformed record in '{0}' at offset {1}: an event of {2} bytes in a record of {3}"
+	    , _path, offset, lsp::eventSize(event), record->size)
+	  );
+    }
+    if (!fieldsWithin(event, record->size))
+    {
+      throw std::runtime_error(
+	  fmt::format("Malformed record in '{0}' at offset {1}: the fields lie outside of its {2} bytes"
+	    , _path, offset, record->size)
+	  );
+    }
+
+    if (_speed > 0)
+    {
+      if (!_events)
+	firstTimestamp = record->timestamp;
+      uint64_t delta = (record->timestamp > firstTimestamp ? record->timestamp - firstTimestamp : 0);
+      auto due = start + std::chrono::nanoseconds(static_cast<uint64_t>(delta / _speed));
+      if (due > clock::now())
+      {
+	flush(); // nothing waits in a batch while the replay is idle
+	while (!stopping.load() && due > clock::now())
+	  std::this_thread::sleep_until(std::min(due, clock::now() + std::chrono::milliseconds(200)));
+      }
+    }
+
+    batch.emplace_back(mapping, event);
+    ++_events;
+    if (batch.size() == _batch)
+      flush();
+
+    offset = next;
+  }
+  flush();
+
+  std::chrono::duration<double> elapsed = clock::now() - start;
+  spdlog::info("replay: {0} events in {1:.3f}s ({2:.0f} events/s)"
+      , _events
+      , elapsed.count()
+      , (elapsed.count() > 0 ? _events / elapsed.count() : 0.0)
+      );
+}
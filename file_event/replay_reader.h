@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lsp_event.h"
+#include "lsprobe_event.h"
+#include "capture.h"
+
+#include <memory>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "sender.h"
+
+namespace lsp
+{
+  // Replays a capture written with lsp::CaptureWriter as if the events came
+  // from lsprobe: events are views into the mapped file, no copies are made.
+  struct ReplayReader
+  {
+    using event_t = lsp::FileEventView;
+    using batch_t = std::vector<event_t>;
+
+    // speed is a multiplier of the captured pace, 0 replays at maximum speed
+    ReplayReader(std::string path, double speed = 1.0, size_t batch = 1);
+
+    ReplayReader(const ReplayReader&) = delete;
+    ReplayReader& operator=(const ReplayReader&) = delete;
+
+    ReplayReader(ReplayReader&&) = default;
+    ReplayReader& operator=(ReplayReader&&) = default;
+
+    ~ReplayReader() = default;
+
+    struct Mapping
+    {
+      const std::byte * data{};
+      size_t size{};
+    };
+
+    std::shared_ptr<const Mapping> map() const;
+
+    void operator()(lsp::Sender<batch_t>&& send);
+
+    std::string _path{};
+    double _speed{1.0};
+    size_t _batch{1};
+
+    size_t _events{};
+
+    static std::atomic_bool stopping;
+  };
+} // lsp
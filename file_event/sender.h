@@ -0,0 +1,11 @@
+#pragma once
+
+#include <functional>
+
+namespace lsp
+{
+  // Where a reader sends its batches: a stlab::sender, or a flow in front of
+  // one that bounds what is queued (see lsmonitor/flow.h).
+  template<typename Batch>
+    using Sender = std::function<void(Batch)>;
+} // lsp
@@ -0,0 +1,48 @@
+#include "slab_pool.h"
+
+lsp::SlabPool::SlabPool(size_t slabSize, size_t maxFree)
+  : _state(std::make_shared<State>())
+{
+  _state->slabSize = slabSize;
+  _state->maxFree = maxFree;
+}
+
+std::shared_ptr<lsp::Slab> lsp::SlabPool::acquire()
+{
+  std::unique_ptr<Slab> slab;
+  {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    if (!_state->free.empty())
+    {
+      slab = std::move(_state->free.back());
+      _state->free.pop_back();
+    }
+    else
+      ++_state->allocated;
+  }
+
+  if (!slab)
+  {
+    slab = std::make_unique<Slab>();
+    slab->data.resize(_state->slabSize);
+  }
+
+  // the deleter holds the state so that slabs outliving the pool are freed safely
+  return std::shared_ptr<Slab>(slab.release(), [state = _state](Slab * s) {state->release(s);});
+}
+
+size_t lsp::SlabPool::allocated() const
+{
+  std::lock_guard<std::mutex> lock(_state->mutex);
+  return _state->allocated;
+}
+
+void lsp::SlabPool::State::release(Slab * slab)
+{
+  std::unique_ptr<Slab> owned(slab);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (free.size() < maxFree)
+    free.emplace_back(std::move(owned));
+  else
+    --allocated;
+}
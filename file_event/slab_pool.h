@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+namespace lsp
+{
+  // A raw buffer that readers fill with records. Events parsed from it keep
+  // a reference to the slab instead of copying their fields out.
+  struct Slab
+  {
+    std::vector<std::byte> data{};
+  };
+
+  // Recycles slabs of a fixed size: a slab goes back to the pool as soon as
+  // the last event referring to it is gone.
+  struct SlabPool
+  {
+    explicit SlabPool(size_t slabSize, size_t maxFree = 64);
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    SlabPool(SlabPool&&) = default;
+    SlabPool& operator=(SlabPool&&) = default;
+
+    ~SlabPool() = default;
+
+    std::shared_ptr<Slab> acquire();
+
+    size_t slabSize() const {return _state->slabSize;}
+    size_t allocated() const;
+
+    struct State
+    {
+      std::mutex mutex{};
+      std::vector<std::unique_ptr<Slab>> free{};
+      size_t slabSize{};
+      size_t maxFree{};
+      size_t allocated{};
+
+      void release(Slab * slab);
+    };
+
+    std::shared_ptr<State> _state;
+  };
+} // lsp
@@ -0,0 +1,127 @@
+#include "synthetic_reader.h"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <limits.h>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+std::atomic_bool lsp::SyntheticReader::stopping{};
+
+namespace
+{
+  // size of the precomputed event sequence: large enough for the stream not
+  // to look periodic to the stages, small enough to stay in cache
+  constexpr size_t sequenceSize = 64 * 1024;
+}
+
+lsp::SyntheticReader::SyntheticReader(Config config)
+  : _config(std::move(config))
+{
+  _config.batch = std::max<size_t>(_config.batch, 1);
+  _config.paths = std::max<size_t>(_config.paths, 1);
+  _config.processes = std::max<size_t>(_config.processes, 1);
+  _config.pids = std::max<size_t>(_config.pids, 1);
+  if (_config.codes.empty())
+    throw std::runtime_error("Synthetic source needs at least one event code");
+}
+
+std::shared_ptr<const lsp::SyntheticReader::Tables> lsp::SyntheticReader::generate() const
+{
+  auto tables = std::make_shared<Tables>();
+  std::mt19937 random(_config.seed);
+
+  std::normal_distribution<double> pathLength(_config.pathLengthMean, _config.pathLengthStddev);
+  tables->paths.reserve(_config.paths);
+  for (size_t i = 0; i < _config.paths; ++i)
+  {
+    std::string path = fmt::format("/synthetic/{0}", i);
+    size_t length = static_cast<size_t>(std::clamp(pathLength(random), 1.0, static_cast<double>(PATH_MAX - 1)));
+    while (path.size() < length)
+      path += fmt::format("/d{0}", random() % 100);
+    tables->paths.emplace_back(std::move(path));
+  }
+
+  tables->processes.reserve(_config.processes);
+  for (size_t i = 0; i < _config.processes; ++i)
+    tables->processes.emplace_back(fmt::format("synthetic-{0}", i));
+
+  std::vector<double> weights;
+  for (const auto& code : _config.codes)
+    weights.push_back(code.second);
+  std::discrete_distribution<size_t> codes(weights.begin(), weights.end());
+  std::uniform_int_distribution<size_t> paths(0, _config.paths - 1);
+  std::uniform_int_distribution<size_t> pids(0, _config.pids - 1);
+
+  // the views point into the tables, which are not touched any more
+  tables->events.reserve(sequenceSize);
+  for (size_t i = 0; i < sequenceSize; ++i)
+  {
+    size_t pid = pids(random);
+    lsp_cred_t cred{};
+    cred.tgid = static_cast<pid_t>(1000 + pid);
+    cred.uid = static_cast<uid_t>(1000 + pid % 16);
+    cred.gid = static_cast<gid_t>(1000 + pid % 8);
+    tables->events.emplace_back(
+	nullptr
+	, static_cast<lsp_event_code_t>(_config.codes[codes(random)].first)
+	, cred
+	, tables->paths[paths(random)]
+	, tables->processes[pid % _config.processes]
+	);
+  }
+  return tables;
+}
+
+void lsp::SyntheticReader::operator()(lsp::Sender<batch_t>&& send)
+{
+  using clock = std::chrono::steady_clock;
+
+  auto tables = generate();
+  const auto& sequence = tables->events;
+
+  // at a fixed rate every batch has its own due time
+  std::chrono::nanoseconds period{0};
+  if (_config.rate > 0)
+    period = std::chrono::nanoseconds(static_cast<long long>(_config.batch * 1e9 / _config.rate));
+
+  auto start = clock::now();
+  auto due = start;
+  size_t next = 0;
+
+  while (!stopping.load() && (!_config.events || _events < _config.events))
+  {
+    size_t count = _config.batch;
+    if (_config.events)
+      count = std::min(count, _config.events - _events);
+
+    batch_t batch;
+    batch.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      // a copy keeps the symbols interned by generate()
+      batch.push_back(sequence[next]);
+      batch.back()._owner = tables;
+      next = (next + 1) % sequence.size();
+    }
+    _events += count;
+    send(std::move(batch));
+
+    if (period.count())
+    {
+      due += period;
+      std::this_thread::sleep_until(due);
+    }
+  }
+
+  std::chrono::duration<double> elapsed = clock::now() - start;
+  spdlog::info("synthetic: {0} events in {1:.3f}s ({2:.0f} events/s)"
+      , _events
+      , elapsed.count()
+      , (elapsed.count() > 0 ? _events / elapsed.count() : 0.0)
+      );
+}
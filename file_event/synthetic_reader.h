@@ -0,0 +1,65 @@
+#pragma once
+
+#include "lsp_event.h"
+#include "lsprobe_event.h"
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <utility>
+#include "sender.h"
+
+namespace lsp
+{
+  // Generates lsprobe-like events without any kernel involvement, to load
+  // the pipeline past the point a real source could.
+  struct SyntheticReader
+  {
+    using event_t = lsp::FileEventView;
+    using batch_t = std::vector<event_t>;
+
+    struct Config
+    {
+      double rate{};                  // events per second, 0 is as fast as possible
+      size_t events{};                // stop after that many events, 0 runs until stopped
+      size_t batch{64};
+      size_t paths{4096};             // distinct file paths
+      double pathLengthMean{48};      // path lengths are normally distributed
+      double pathLengthStddev{16};
+      size_t processes{64};           // distinct process names
+      size_t pids{256};               // distinct pids, a pid always runs the same process
+      std::vector<std::pair<long, double>> codes{{1, 1.0}}; // event code and its weight
+      uint32_t seed{42};
+    };
+
+    explicit SyntheticReader(Config config);
+
+    SyntheticReader(const SyntheticReader&) = delete;
+    SyntheticReader& operator=(const SyntheticReader&) = delete;
+
+    SyntheticReader(SyntheticReader&&) = default;
+    SyntheticReader& operator=(SyntheticReader&&) = default;
+
+    ~SyntheticReader() = default;
+
+    // events the reader cycles through; the strings live in the tables they own
+    struct Tables
+    {
+      std::vector<std::string> paths{};
+      std::vector<std::string> processes{};
+      batch_t events{};
+    };
+
+    std::shared_ptr<const Tables> generate() const;
+
+    void operator()(lsp::Sender<batch_t>&& send);
+
+    Config _config{};
+    size_t _events{};
+
+    static std::atomic_bool stopping;
+  };
+} // lsp
@@ -0,0 +1,225 @@
+#include "uring.h"
+
+#include "fmt/format.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+
+#ifdef LSP_HAVE_IO_URING
+
+namespace
+{
+  int io_uring_setup(unsigned entries, io_uring_params * params)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+  }
+
+  int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+  }
+
+  int io_uring_register(int fd, unsigned opcode, void * arg, unsigned argCount)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+  }
+
+  template<typename T>
+    T * at(void * base, unsigned offset)
+    {
+      return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+    }
+}
+
+lsp::Uring::Uring(unsigned entries)
+{
+  io_uring_params params{};
+  _fd = io_uring_setup(entries, &params);
+  if (_fd == -1)
+  {
+    std::error_code err(errno, std::system_category());
+    throw std::runtime_error(
+	fmt::format("Unable to set up io_uring: {0} - {1}", err.value(), err.message())
+	);
+  }
+
+  _sqEntries = params.sq_entries;
+  _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+  _sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+  if (_sqRing != MAP_FAILED)
+  {
+    _cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+      ? _sqRing
+      : ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+  }
+  if (_cqRing != MAP_FAILED && _cqRing)
+  {
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe *>(
+	::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES)
+	);
+  }
+
+  if (_sqRing == MAP_FAILED || _cqRing == MAP_FAILED || !_cqRing || _sqes == MAP_FAILED)
+  {
+    std::error_code err(errno, std::system_category());
+    if (_sqRing == MAP_FAILED) _sqRing = nullptr;
+    if (_cqRing == MAP_FAILED) _cqRing = nullptr;
+    if (_sqes == MAP_FAILED) _sqes = nullptr;
+    release();
+    throw std::runtime_error(
+	fmt::format("Unable to map io_uring rings: {0} - {1}", err.value(), err.message())
+	);
+  }
+
+  _sqHead = at<unsigned>(_sqRing, params.sq_off.head);
+  _sqTail = at<unsigned>(_sqRing, params.sq_off.tail);
+  _sqMask = at<unsigned>(_sqRing, params.sq_off.ring_mask);
+  _sqArray = at<unsigned>(_sqRing, params.sq_off.array);
+
+  _cqHead = at<unsigned>(_cqRing, params.cq_off.head);
+  _cqTail = at<unsigned>(_cqRing, params.cq_off.tail);
+  _cqMask = at<unsigned>(_cqRing, params.cq_off.ring_mask);
+  _cqes = at<io_uring_cqe>(_cqRing, params.cq_off.cqes);
+}
+
+lsp::Uring::~Uring()
+{
+  release();
+}
+
+void lsp::Uring::release()
+{
+  if (_sqes)
+    ::munmap(_sqes, _sqesSize);
+  if (_cqRing && _cqRing != _sqRing)
+    ::munmap(_cqRing, _cqRingSize);
+  if (_sqRing)
+    ::munmap(_sqRing, _sqRingSize);
+  if (_fd != -1)
+    ::close(_fd);
+  _sqes = nullptr;
+  _cqRing = _sqRing = nullptr;
+  _fd = -1;
+}
+
+bool lsp::Uring::supported()
+{
+  try
+  {
+    Uring ring(2);
+    std::vector<std::byte> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    auto probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+    if (io_uring_register(ring._fd, IORING_REGISTER_PROBE, probe, 256) == -1)
+      return false;
+    return (probe->last_op >= IORING_OP_READ)
+      && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+  }
+  catch (const std::exception&)
+  {
+    return false;
+  }
+}
+
+io_uring_sqe * lsp::Uring::nextSqe()
+{
+  unsigned tail = *_sqTail;
+  unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+  if (tail - head >= _sqEntries)
+    return nullptr;
+
+  io_uring_sqe * sqe = &_sqes[tail & *_sqMask];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  return sqe;
+}
+
+void lsp::Uring::push()
+{
+  unsigned tail = *_sqTail;
+  unsigned index = tail & *_sqMask;
+  _sqArray[index] = index;
+  __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+  ++_toSubmit;
+}
+
+bool lsp::Uring::prepareRead(int fd, void * buffer, unsigned size, uint64_t userData)
+{
+  io_uring_sqe * sqe = nextSqe();
+  if (!sqe)
+    return false;
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(buffer);
+  sqe->len = size;
+  sqe->off = static_cast<uint64_t>(-1); // current position, the only one a stream has
+  sqe->user_data = userData;
+  push();
+  return true;
+}
+
+bool lsp::Uring::prepareTimeout(long long nanoseconds, uint64_t userData)
+{
+  io_uring_sqe * sqe = nextSqe();
+  if (!sqe)
+    return false;
+  // the timespec must stay valid until submission; one timeout is in flight at a time
+  _timeout.tv_sec = nanoseconds / 1000000000;
+  _timeout.tv_nsec = nanoseconds % 1000000000;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<uint64_t>(&_timeout);
+  sqe->len = 1;
+  sqe->user_data = userData;
+  push();
+  return true;
+}
+
+bool lsp::Uring::prepareCancel(uint64_t targetUserData, uint64_t userData)
+{
+  io_uring_sqe * sqe = nextSqe();
+  if (!sqe)
+    return false;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = targetUserData;
+  sqe->user_data = userData;
+  push();
+  return true;
+}
+
+int lsp::Uring::submit(unsigned waitCount)
+{
+  int submitted = io_uring_enter(_fd, _toSubmit, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0);
+  ++_enters;
+  if (submitted > 0)
+    _toSubmit -= std::min<unsigned>(_toSubmit, submitted);
+  return submitted;
+}
+
+#else // LSP_HAVE_IO_URING
+
+lsp::Uring::Uring(unsigned)
+{
+  throw std::runtime_error("io_uring is not available in this build");
+}
+
+lsp::Uring::~Uring() = default;
+
+bool lsp::Uring::supported() {return false;}
+bool lsp::Uring::prepareRead(int, void *, unsigned, uint64_t) {return false;}
+bool lsp::Uring::prepareTimeout(long long, uint64_t) {return false;}
+bool lsp::Uring::prepareCancel(uint64_t, uint64_t) {return false;}
+int lsp::Uring::submit(unsigned) {errno = ENOSYS; return -1;}
+
+#endif // LSP_HAVE_IO_URING
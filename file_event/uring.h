@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LSP_HAVE_IO_URING 1
+#endif
+
+namespace lsp
+{
+  // A bare io_uring(7) instance driven through the raw syscalls: enough to
+  // keep reads in flight and reap their completions, nothing more.
+  struct Uring
+  {
+    explicit Uring(unsigned entries);
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    ~Uring();
+
+    // whether the kernel provides io_uring with IORING_OP_READ support
+    static bool supported();
+
+    bool prepareRead(int fd, void * buffer, unsigned size, uint64_t userData);
+    bool prepareTimeout(long long nanoseconds, uint64_t userData);
+    bool prepareCancel(uint64_t targetUserData, uint64_t userData);
+
+    // submits prepared entries and waits for at least waitCount completions,
+    // returns -1 with errno set on failure
+    int submit(unsigned waitCount);
+
+    template<typename F>
+      size_t drain(F&& f)
+      {
+#ifdef LSP_HAVE_IO_URING
+	unsigned head = *_cqHead;
+	unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+	size_t count = 0;
+	while (head != tail)
+	{
+	  const io_uring_cqe& cqe = _cqes[head & *_cqMask];
+	  f(cqe.user_data, cqe.res);
+	  ++head;
+	  ++count;
+	}
+	__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+	return count;
+#else
+	(void)f;
+	return 0;
+#endif
+      }
+
+    size_t _enters{};
+
+#ifdef LSP_HAVE_IO_URING
+    io_uring_sqe * nextSqe();
+    void push();
+    void release();
+
+    int _fd{-1};
+    unsigned _toSubmit{};
+    unsigned _sqEntries{};
+
+    void * _sqRing{};
+    size_t _sqRingSize{};
+    void * _cqRing{};
+    size_t _cqRingSize{};
+    io_uring_sqe * _sqes{};
+    size_t _sqesSize{};
+
+    unsigned * _sqHead{};
+    unsigned * _sqTail{};
+    unsigned * _sqMask{};
+    unsigned * _sqArray{};
+
+    unsigned * _cqHead{};
+    unsigned * _cqTail{};
+    unsigned * _cqMask{};
+    io_uring_cqe * _cqes{};
+
+    __kernel_timespec _timeout{};
+#endif
+  };
+} // lsp
@@ -0,0 +1,197 @@
+#include "uring_ingest.h"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <errno.h>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  constexpr uint64_t timeoutTag = std::numeric_limits<uint64_t>::max();
+  constexpr uint64_t cancelTag = timeoutTag - 1;
+  constexpr long long tickNs = 200 * 1000 * 1000; // how often the stop flag is checked
+}
+
+lsp::UringIngest::UringIngest(unsigned depth)
+  : _depth(std::max(depth, 1u))
+{}
+
+lsp::UringIngest::~UringIngest()
+{
+  _ring.reset();
+}
+
+void lsp::UringIngest::add(std::string name, int fd, size_t bufferSize, complete_t complete, bool stream)
+{
+  _sources.push_back(Source{std::move(name), fd, SlabPool(bufferSize), std::move(complete), stream});
+}
+
+bool lsp::UringIngest::active() const
+{
+  for (const auto& source : _sources)
+    if (!source.done || source.inflight)
+      return true;
+  return false;
+}
+
+bool lsp::UringIngest::submitRead(size_t sourceIndex)
+{
+  if (_freeRequests.empty())
+    return false;
+
+  Source& source = _sources[sourceIndex];
+  if (source.stream && source.inflight)
+    return false;
+
+  size_t tag = _freeRequests.back();
+  Request& request = _requests[tag];
+  request.source = sourceIndex;
+  request.slab = source.slabs.acquire();
+  request.carried = source.tailSize;
+  if (request.carried)
+    std::memcpy(request.slab->data.data(), source.tail->data.data() + source.tailOffset, request.carried);
+
+  std::byte * buffer = request.slab->data.data() + request.carried;
+  if (!_ring->prepareRead(source.fd, buffer, request.slab->data.size() - request.carried, tag))
+  {
+    request.slab.reset();
+    return false;
+  }
+  source.tail.reset();
+  source.tailSize = 0;
+  _freeRequests.pop_back();
+  ++source.inflight;
+  return true;
+}
+
+void lsp::UringIngest::complete(uint64_t tag, int result, bool stopping)
+{
+  if (tag == timeoutTag)
+  {
+    _timeoutArmed = false;
+    return;
+  }
+  if (tag == cancelTag || tag >= _requests.size())
+    return;
+
+  Request& request = _requests[tag];
+  Source& source = _sources[request.source];
+  auto slab = std::move(request.slab);
+  _freeRequests.push_back(tag);
+  --source.inflight;
+
+  if (result > 0)
+  {
+    ++source.completions;
+    size_t available = request.carried + static_cast<size_t>(result);
+    size_t parsed = source.complete(slab, available);
+    if (parsed < available)
+    {
+      if (!source.stream || available - parsed >= slab->data.size())
+      {
+	source.done = true;
+	if (!_error)
+	{
+	  _error = EPROTO; // a record that cannot be completed
+	  _errorSource = source.name;
+	}
+	return;
+      }
+      source.tail = std::move(slab);
+      source.tailOffset = parsed;
+      source.tailSize = available - parsed;
+    }
+  }
+  else if (result == 0)
+  {
+    source.done = true;
+  }
+  else if (result == -ECANCELED)
+  {
+    return;
+  }
+  else if (result != -EINTR && result != -EAGAIN)
+  {
+    source.done = true;
+    if (!_error)
+    {
+      _error = -result;
+      _errorSource = source.name;
+    }
+    return;
+  }
+
+  if (!stopping && !source.done)
+    submitRead(request.source);
+}
+
+void lsp::UringIngest::cancelAll()
+{
+  for (size_t tag = 0; tag < _requests.size(); ++tag)
+    if (_requests[tag].slab)
+      _ring->prepareCancel(tag, cancelTag);
+
+  // Reads must not complete into freed slabs: wait for all of them,
+  // giving up after a few ticks on a read the kernel would not cancel.
+  for (int ticks = 0; ticks < 10 && active(); ++ticks)
+  {
+    for (auto& source : _sources)
+      source.done = true;
+    if (!_timeoutArmed)
+      _timeoutArmed = _ring->prepareTimeout(tickNs, timeoutTag);
+    if (_ring->submit(1) == -1 && errno != EINTR)
+      break;
+    _ring->drain([this](uint64_t tag, int result) {complete(tag, result, true);});
+  }
+}
+
+void lsp::UringIngest::run(const std::function<bool()>& stopping)
+{
+  _ring = std::make_unique<Uring>(_depth * _sources.size() + 2);
+  _requests.resize(_depth * _sources.size());
+  _freeRequests.clear();
+  for (size_t tag = _requests.size(); tag > 0; --tag)
+    _freeRequests.push_back(tag - 1);
+
+  for (size_t source = 0; source < _sources.size(); ++source)
+    for (unsigned i = 0; i < _depth; ++i)
+      submitRead(source);
+
+  size_t completions = 0;
+  while (!stopping() && active() && !_error)
+  {
+    if (!_timeoutArmed)
+      _timeoutArmed = _ring->prepareTimeout(tickNs, timeoutTag);
+
+    if (_ring->submit(1) == -1)
+    {
+      if (errno == EINTR)
+	continue;
+      std::error_code err(errno, std::system_category());
+      throw std::runtime_error(
+	  fmt::format("Unable to submit io_uring requests: {0} - {1}", err.value(), err.message())
+	  );
+    }
+    bool stop = stopping();
+    completions += _ring->drain([this, stop](uint64_t tag, int result) {complete(tag, result, stop);});
+  }
+
+  cancelAll();
+
+  spdlog::info("io_uring: {0} completions in {1} io_uring_enter calls", completions, _ring->_enters);
+  for (const auto& source : _sources)
+    spdlog::debug("io_uring: {0}: {1} reads completed", source.name, source.completions);
+
+  if (_error)
+  {
+    std::error_code err(_error, std::system_category());
+    throw std::runtime_error(
+	fmt::format("Unable to read {0} events: {1} - {2}", _errorSource, err.value(), err.message())
+	);
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "uring.h"
+#include "slab_pool.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+
+namespace lsp
+{
+  // Keeps several reads in flight on every added source and completes all
+  // of them on the calling thread, so that sources need no thread of their own.
+  // The records of a stream source may span two reads: it keeps a single
+  // read in flight, so its reads complete in order, and the tail its
+  // completion did not parse is moved to the start of the next read.
+  struct UringIngest
+  {
+    // returns the bytes of the slab it parsed, the rest is a partial record
+    using complete_t = std::function<size_t(const std::shared_ptr<Slab>&, size_t)>;
+
+    explicit UringIngest(unsigned depth = 4);
+
+    UringIngest(const UringIngest&) = delete;
+    UringIngest& operator=(const UringIngest&) = delete;
+
+    ~UringIngest();
+
+    void add(std::string name, int fd, size_t bufferSize, complete_t complete, bool stream = false);
+    void run(const std::function<bool()>& stopping);
+
+    struct Source
+    {
+      std::string name{};
+      int fd{-1};
+      SlabPool slabs;
+      complete_t complete{};
+      bool stream{};
+      std::shared_ptr<Slab> tail{}; // holds the partial record of a stream
+      size_t tailOffset{};
+      size_t tailSize{};
+      size_t inflight{};
+      size_t completions{};
+      bool done{};
+    };
+
+    struct Request
+    {
+      size_t source{};
+      std::shared_ptr<Slab> slab{};
+      size_t carried{}; // bytes of a partial record ahead of the read
+    };
+
+    bool submitRead(size_t source);
+    void complete(uint64_t tag, int result, bool stopping);
+    void cancelAll();
+    bool active() const;
+
+    unsigned _depth{};
+    std::vector<Source> _sources{};
+    std::vector<Request> _requests{};
+    std::vector<size_t> _freeRequests{};
+    bool _timeoutArmed{};
+    int _error{};
+    std::string _errorSource{};
+
+    std::unique_ptr<Uring> _ring{}; // goes first, before the buffers it reads into
+  };
+} // lsp
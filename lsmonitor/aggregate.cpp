@@ -0,0 +1,111 @@
+#include "aggregate.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  std::atomic<uint64_t> nextId{1};
+
+  // the shard the calling thread used last, and of which aggregate
+  thread_local uint64_t cachedId{};
+  thread_local lsp::Aggregate::Shard * cachedShard{};
+}
+
+unsigned lsp::parseGroupBy(const std::string& fields)
+{
+  unsigned groupBy = 0;
+  std::istringstream in(fields);
+  std::string field;
+  while (std::getline(in, field, ','))
+  {
+    if (field == "process") groupBy |= Aggregate::PROCESS;
+    else if (field == "pid") groupBy |= Aggregate::PID;
+    else if (field == "uid") groupBy |= Aggregate::UID;
+    else if (field == "gid") groupBy |= Aggregate::GID;
+    else if (field == "code") groupBy |= Aggregate::CODE;
+    else if (field == "file") groupBy |= Aggregate::FILENAME;
+    else
+      throw std::runtime_error(
+	  fmt::format("Unknown group by field: '{0}', expected process, pid, uid, gid, code or file", field)
+	  );
+  }
+  return groupBy;
+}
+
+lsp::Aggregate::Aggregate(Config config)
+  : _config(config)
+  , _id(nextId.fetch_add(1))
+{}
+
+lsp::Aggregate::Shard& lsp::Aggregate::shard()
+{
+  if (cachedId == _id)
+    return *cachedShard;
+
+  std::thread::id self = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = std::find_if(_shards.begin(), _shards.end(), [self](const auto& s) {return s.first == self;});
+  if (it == _shards.end())
+  {
+    _shards.emplace_back(self, std::make_unique<Shard>());
+    it = std::prev(_shards.end());
+  }
+  cachedId = _id;
+  cachedShard = it->second.get();
+  return *cachedShard;
+}
+
+std::string lsp::Aggregate::label(const Key& key, const Count& count) const
+{
+  std::string label;
+  auto append = [&label](auto&&... args)
+  {
+    if (!label.empty())
+      label += " : ";
+    label += fmt::format(std::forward<decltype(args)>(args)...);
+  };
+  const unsigned groupBy = _config.groupBy;
+  if (groupBy & PROCESS) append("{0}", count.process);
+  if (groupBy & PID) append("pid[{0}]", key.pid);
+  if (groupBy & UID) append("uid[{0}]", key.uid);
+  if (groupBy & GID) append("gid[{0}]", key.gid);
+  if (groupBy & CODE) append("op[{0}]", key.code);
+  if (groupBy & FILENAME) append("{0}", count.file);
+  return label;
+}
+
+std::map<std::string, size_t> lsp::Aggregate::stats() const
+{
+  std::map<std::string, size_t> merged;
+  size_t events = 0;
+  size_t overflow = 0;
+  size_t keys = 0;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto& [id, shard] : _shards)
+  {
+    std::lock_guard<std::mutex> shardLock(shard->_mutex);
+    for (const auto& [key, count] : shard->_counts)
+    {
+      // shards key the same tuple alike, unless a symbol was evicted in
+      // between: the labels merge those too
+      merged[label(key, count)] += count.events;
+      events += count.events;
+    }
+    keys += shard->_counts.size();
+    overflow += shard->_overflow;
+  }
+
+  if (_shards.empty())
+    return merged;
+  merged["aggregate: events"] = events + overflow;
+  merged["aggregate: keys"] = keys;
+  merged["aggregate: shards"] = _shards.size();
+  merged["aggregate: events over the key bound"] = overflow;
+  return merged;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "lspredicate/event_traits.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lsp
+{
+  // FIELD[,FIELD...] of process, pid, uid, gid, code and file, a mask of
+  // Aggregate::Field
+  unsigned parseGroupBy(const std::string& fields);
+
+  // Counts events per distinct tuple of the grouped fields. Events are keyed
+  // on their fields as read through event_traits, the strings by their
+  // interned symbol, so counting one does not format it and does not compare
+  // strings. Every thread that adds has a shard of its own, a hash map only
+  // it writes to, so the stages of both sources count in parallel without
+  // contention; the shards are merged when the counters are read. The
+  // distinct keys are bounded over all shards, a key held by several counts
+  // once per shard: events of a key beyond the bound are counted as overflow
+  // only.
+  struct Aggregate
+  {
+    // the event fields an aggregate groups by
+    enum Field : unsigned
+    {
+      PROCESS    = 1 << 0
+      , PID      = 1 << 1
+      , UID      = 1 << 2
+      , GID      = 1 << 3
+      , CODE     = 1 << 4
+      , FILENAME = 1 << 5
+    };
+
+    struct Config
+    {
+      unsigned groupBy{PROCESS | UID | CODE | FILENAME};
+      size_t maxKeys{65536}; // distinct keys at most, over all shards
+    };
+
+    // the fields not grouped by are 0
+    struct Key
+    {
+      uint64_t process{}; // symbol, or the hash of the string if it is not interned
+      uint64_t file{};
+      long pid{};
+      long uid{};
+      long gid{};
+      long code{};
+
+      bool operator==(const Key& other) const
+      {
+	return (process == other.process && file == other.file && pid == other.pid
+	    && uid == other.uid && gid == other.gid && code == other.code);
+      }
+    };
+
+    struct KeyHash
+    {
+      size_t operator()(const Key& key) const
+      {
+	uint64_t h = key.file;
+	for (uint64_t field : {key.process, uint64_t(key.pid), uint64_t(key.uid), uint64_t(key.gid), uint64_t(key.code)})
+	  h = (h ^ field) * 0x9e3779b97f4a7c15ull;
+	return std::hash<uint64_t>{}(h);
+      }
+    };
+
+    // the strings are copied once per key, the interner may evict the symbols
+    struct Count
+    {
+      size_t events{};
+      std::string process{};
+      std::string file{};
+    };
+
+    struct Shard
+    {
+      std::mutex _mutex{}; // taken by its thread once per batch, by readers to merge
+      std::unordered_map<Key, Count, KeyHash> _counts{};
+      size_t _overflow{}; // events of keys beyond maxKeys
+    };
+
+    explicit Aggregate(Config config);
+
+    Aggregate(const Aggregate&) = delete;
+    Aggregate& operator=(const Aggregate&) = delete;
+
+    template<typename Batch>
+      void add(const Batch& batch)
+      {
+	if (batch.empty())
+	  return;
+	Shard& shard = this->shard();
+	std::lock_guard<std::mutex> lock(shard._mutex);
+	for (const auto& event : batch)
+	  add(shard, event);
+      }
+
+    template<typename Event>
+      void add(Shard& shard, const Event& event)
+      {
+	using traits = lsp::predicate::event_traits<Event>;
+	const unsigned groupBy = _config.groupBy;
+
+	Key key;
+	if (groupBy & PROCESS) key.process = symbolKey(traits::process_symbol(event), traits::process(event));
+	if (groupBy & FILENAME) key.file = symbolKey(traits::filename_symbol(event), traits::filename(event));
+	if (groupBy & PID) key.pid = traits::pid(event);
+	if (groupBy & UID) key.uid = traits::uid(event);
+	if (groupBy & GID) key.gid = traits::gid(event);
+	if (groupBy & CODE) key.code = traits::code(event);
+
+	auto it = shard._counts.find(key);
+	if (it == shard._counts.end())
+	{
+	  if (_keys.fetch_add(1, std::memory_order_relaxed) >= _config.maxKeys)
+	  {
+	    _keys.fetch_sub(1, std::memory_order_relaxed);
+	    ++shard._overflow;
+	    return;
+	  }
+	  Count count;
+	  if (groupBy & PROCESS) count.process.assign(traits::process(event));
+	  if (groupBy & FILENAME) count.file.assign(traits::filename(event));
+	  it = shard._counts.emplace(key, std::move(count)).first;
+	}
+	++it->second.events;
+      }
+
+    // interned strings are keyed by their symbol, the others by a hash with
+    // the top bit set, which symbols leave clear
+    static uint64_t symbolKey(uint64_t symbol, std::string_view text)
+    {
+      return (symbol ? symbol : (std::hash<std::string_view>{}(text) | (uint64_t(1) << 63)));
+    }
+
+    // the shard of the calling thread
+    Shard& shard();
+
+    // the shards merged, a line per key for printStats, and the counters of
+    // the aggregate itself as `aggregate: COUNTER`
+    std::map<std::string, size_t> stats() const;
+
+    std::string label(const Key& key, const Count& count) const;
+
+    Config _config;
+    uint64_t _id; // tells the thread caches of different aggregates apart
+    std::atomic<size_t> _keys{};
+
+    mutable std::mutex _mutex{}; // guards _shards, not what they hold
+    std::vector<std::pair<std::thread::id, std::unique_ptr<Shard>>> _shards{};
+  };
+} // lsp
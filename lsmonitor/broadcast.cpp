@@ -1,4 +1,5 @@
 #include "broadcast.h"
+#include "debug.h"
 
 #include "stlab/concurrency/channel.hpp"
 
@@ -96,7 +97,7 @@ void ctl::broadcast::listen()
 void ctl::broadcast::send(std::string&& value)
 {
   _value = std::move(value);
-  spdlog::debug("{0}: sending {1}", __PRETTY_FUNCTION__, _value);
+  LSP_DEBUG("{0}: sending {1}", __PRETTY_FUNCTION__, _value);
   for (auto fd : _dataFds)
   {
     if (::send(fd, _value.c_str(), _value.size() + 1, MSG_NOSIGNAL) == -1)
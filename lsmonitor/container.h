@@ -2,8 +2,12 @@
 
 #include <stlab/concurrency/channel.hpp>
 #include <stlab/concurrency/default_executor.hpp>
+#include "debug.h"
 
 #include <type_traits>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
 
 namespace lsp
 {
@@ -54,7 +58,7 @@ namespace lsp
       auto yield()
       {
 	auto value = std::move(_container);
-	spdlog::debug("{0}: push container of {1} elements", __PRETTY_FUNCTION__, value.size());
+	LSP_DEBUG("{0}: push container of {1} elements", __PRETTY_FUNCTION__, value.size());
 	_state = stlab::await_forever;
 	return value;
       }
@@ -79,6 +83,120 @@ namespace lsp
       }
     };
 
+  // Splits a batch coming from a reader into separate values
+  template <typename Batch>
+    struct unbatch
+    {
+      using value_type = typename Batch::value_type;
+
+      Batch _batch{};
+      size_t _next{};
+      stlab::process_state_scheduled _state = stlab::await_forever;
+
+      void await(Batch&& batch)
+      {
+	_batch = std::move(batch);
+	_next = 0;
+	_state = (_batch.empty() ? stlab::await_forever : stlab::yield_immediate);
+      }
+
+      auto yield()
+      {
+	auto value = std::move(_batch[_next++]);
+	if (_next == _batch.size())
+	{
+	  _batch.clear();
+	  _state = stlab::await_forever;
+	}
+	return value;
+      }
+
+      auto state() const
+      {
+	return _state;
+      }
+
+      void set_error(std::exception_ptr error)
+      {
+	try
+	{
+	  if (error)
+	    std::rethrow_exception(error);
+	}
+	catch (const std::exception& e)
+	{
+	  spdlog::critical("{0} : {1}", __PRETTY_FUNCTION__, e.what());
+	  throw;
+	}
+      }
+    };
+
+  // Joins small batches into one of up to _capacity events. A batch goes on
+  // once it is full, or once _latency has passed since its first event
+  // arrived, so a quiet source does not hold events back. A batch already
+  // at capacity passes as it is.
+  template <typename Batch>
+    struct rebatch
+    {
+      size_t _capacity = 1;
+      std::chrono::nanoseconds _latency{};
+      Batch _batch{};
+      std::chrono::steady_clock::time_point _deadline{};
+      stlab::process_state_scheduled _state = stlab::await_forever;
+
+      rebatch(size_t capacity, std::chrono::nanoseconds latency)
+	: _capacity(capacity)
+	, _latency(latency)
+      {}
+
+      void await(Batch&& batch)
+      {
+	auto now = std::chrono::steady_clock::now();
+	if (_batch.empty())
+	{
+	  _batch = std::move(batch);
+	  _deadline = now + _latency;
+	}
+	else
+	  std::move(batch.begin(), batch.end(), std::back_inserter(_batch));
+
+	if (_batch.size() >= _capacity || now >= _deadline)
+	  _state = stlab::yield_immediate;
+	else if (_batch.empty())
+	  _state = stlab::await_forever;
+	else // stlab calls yield() if nothing arrives until then
+	  _state = stlab::process_state_scheduled{stlab::process_state::await, _deadline - now};
+      }
+
+      auto yield()
+      {
+	auto batch = std::move(_batch);
+	_batch.clear();
+	_state = stlab::await_forever;
+	LSP_DEBUG("{0}: {1} events", __PRETTY_FUNCTION__, batch.size());
+	return batch;
+      }
+
+      auto state() const
+      {
+	return _state;
+      }
+
+      void set_error(std::exception_ptr error)
+      {
+	try
+	{
+	  if (error)
+	    std::rethrow_exception(error);
+	}
+	catch (const std::exception& e)
+	{
+	  spdlog::critical("{0} : {1}", __PRETTY_FUNCTION__, e.what());
+	  throw;
+	}
+      }
+    };
+
   // template <typename Container, typename Value = void>
   //   struct queue{};
 
@@ -171,7 +289,7 @@ namespace lsp
       template<typename T>
       void await(T&& value)
       {
-	spdlog::debug("{0}: {1} -> {2} now", __PRETTY_FUNCTION__, value->filename, _container.size());
+	LSP_DEBUG("{0}: {1} -> {2} now", __PRETTY_FUNCTION__, value->filename, _container.size());
 	_container.insert(std::move(value));
 	if (_container.size() == _capacity)
 	  _state = stlab::yield_immediate;
@@ -184,7 +302,7 @@ namespace lsp
 	auto value = std::move(_container.extract(_container.begin()).value());
 	if (_container.empty())
 	  _state = stlab::await_forever;
-	spdlog::debug("{0}: {1} -> {2} left", __PRETTY_FUNCTION__, value->filename, _container.size());
+	LSP_DEBUG("{0}: {1} -> {2} left", __PRETTY_FUNCTION__, value->filename, _container.size());
 	return value;
       }
 
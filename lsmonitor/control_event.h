@@ -2,6 +2,7 @@
 
 #include <string>
 #include <sys/socket.h>
+#include <unistd.h>
 #include <cstring>
 
 #include "utility.h"
@@ -13,16 +14,27 @@ namespace ctl
     NONE
     , DISABLE
     , ENABLE
+    , EXPR   // `expr EXPRESSION`, replaces the predicate
+    , RULES  // `rules FILE`, replaces the rule set
+    , STATS  // `stats`, answers the queue and event pool counters
   };
 
   struct ControlEvent
   {
-    ControlEvent(const char * text, ssize_t size, struct ucred ucred)
+    ControlEvent(const char * text, ssize_t size, struct ucred ucred, int replyFd = -1)
       : code(
 	  (!text || !size) ? EventCode::NONE :
 	  (size == 3 && strncmp(text, "off", 3) == 0 ? EventCode::DISABLE :
 	  (size == 2 && strncmp(text, "on" , 2) == 0 ? EventCode::ENABLE  :
-	  (EventCode::NONE)))
+	  (size > 5 && strncmp(text, "expr " , 5) == 0 ? EventCode::EXPR  :
+	  (size > 6 && strncmp(text, "rules ", 6) == 0 ? EventCode::RULES :
+	  (size == 5 && strncmp(text, "stats", 5) == 0 ? EventCode::STATS :
+	  (EventCode::NONE))))))
+	  )
+      , argument(
+	  code == EventCode::EXPR  ? std::string(text + 5, size - 5) :
+	  code == EventCode::RULES ? std::string(text + 6, size - 6) :
+	  std::string()
 	  )
       , pid(ucred.pid)
       , uid(ucred.uid)
@@ -30,15 +42,34 @@ namespace ctl
       , process(linux::getPidComm(ucred.pid))
       , user("n/a"/*linux::getPwgroup(ucred.uid)*/)
       , group("n/a"/*linux::getPwgroup(ucred.gid)*/) // FIXME: causes recursion on /etc/group
+      , replyFd(replyFd)
     {}
 
+    ControlEvent(const ControlEvent&) = delete;
+    ControlEvent& operator=(const ControlEvent&) = delete;
+
+    ~ControlEvent()
+    {
+      if (replyFd >= 0)
+	::close(replyFd);
+    }
+
+    // answers the peer on the connection the command came from
+    void reply(const std::string& text) const
+    {
+      if (replyFd >= 0)
+	::send(replyFd, text.c_str(), text.size(), MSG_NOSIGNAL);
+    }
+
     EventCode code{};
+    std::string argument{};
     pid_t pid{};
     uid_t uid{};
     gid_t gid{};
     std::string process{};
     std::string user{};
     std::string group{};
+    int replyFd{-1};
   };
 
 } // ctl
@@ -7,11 +7,13 @@
 #include "spdlog/spdlog.h"
 
 #include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <errno.h>
 #include <cstring>
 #include <cstddef>
+#include <cctype>
 
 namespace fs = std::experimental::filesystem;
 
@@ -33,11 +35,11 @@ void ctl::Reader::openTheWormhole()
   if (fs::exists(_path, err))
     fs::remove(_path, err);
   else
-    fs::create_directories(_path.remove_filename(), err);
+    fs::create_directories(_path.parent_path(), err);
 
   if (err)
     throw std::runtime_error(
-	fmt::format("Unable to create '{0}': {1} - {2}", _path.remove_filename().native(), err.value(), err.message())
+	fmt::format("Unable to create '{0}': {1} - {2}", _path.parent_path().native(), err.value(), err.message())
 	);
 
   _fd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
@@ -85,15 +87,19 @@ void ctl::Reader::handleEvents(int dataFd)
 	);
   }
 
-  std::vector<char> buffer(64);
+  // a predicate has to fit in one packet
+  std::vector<char> buffer(64 * 1024);
   buffer[buffer.size() - 1] = 0;
 
   ssize_t bytes = ::read(dataFd, buffer.data(), buffer.size() - 2);
+  while (bytes > 0 && std::isspace(static_cast<unsigned char>(buffer[bytes - 1])))
+    --bytes;
   if (bytes > 0)
   {
     buffer[bytes] = 0;
     spdlog::debug("read {0} bytes from the connection on '{1}': {2}", bytes, _path.native(), buffer.data());
-    _send(std::make_unique<ControlEvent>(buffer.data(), bytes, ucred));
+    // the command is handled asynchronously, its event keeps the connection to reply on
+    _send(std::make_unique<ControlEvent>(buffer.data(), bytes, ucred, ::dup(dataFd)));
   }
   else if (bytes < 0)
   {
@@ -121,8 +127,14 @@ void ctl::Reader::operator()(stlab::sender<event_t>&& send)
 
   _send = std::move(send);
 
+  // polls with a timeout: the signal that stops the readers may land on another thread
+  struct pollfd fds[1] = {{_fd, POLLIN, 0}};
   while(!stopping.load())
   {
+    int ready = ::poll(fds, 1, 200);
+    if (ready == 0 || (ready == -1 && errno == EINTR))
+      continue;
+
     int dataFd = ::accept(_fd, NULL, NULL);
     if (dataFd != -1)
     {
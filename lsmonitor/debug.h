@@ -0,0 +1,17 @@
+#pragma once
+
+#include "spdlog/spdlog.h"
+
+// Debug logging for the code run per event. The arguments, e.g. a
+// stringify(), are only evaluated when debug is on at runtime, and building
+// with -DLSMONITOR_HOT_DEBUG=OFF removes the statements altogether.
+#if defined(LSMONITOR_NO_HOT_DEBUG)
+#define LSP_DEBUG(...) static_cast<void>(0)
+#else
+#define LSP_DEBUG(...) \
+  do \
+  { \
+    if (spdlog::should_log(spdlog::level::debug)) \
+      spdlog::debug(__VA_ARGS__); \
+  } while (false)
+#endif
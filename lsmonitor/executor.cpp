@@ -0,0 +1,205 @@
+#include "executor.h"
+
+#include "spdlog/spdlog.h"
+#include "fmt/format.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+
+namespace
+{
+  // the worker the calling thread is, if any
+  thread_local const lsp::Executor * currentExecutor{};
+  thread_local unsigned currentWorker{};
+}
+
+lsp::Executor::Executor(Config config)
+  : _config(std::move(config))
+{
+  unsigned workers = _config.workers ? _config.workers : std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < workers; ++i)
+    _workers.push_back(std::make_unique<Worker>());
+  for (unsigned i = 0; i < workers; ++i)
+    _workers[i]->_thread = std::thread(&Executor::run, this, i);
+
+  spdlog::info("Running the stages on {0} workers{1}{2}..."
+      , workers
+      , (_config.cpus.empty() ? "" : ", pinned")
+      , (_config.sticky ? ", a worker per source" : "")
+      );
+}
+
+lsp::Executor::~Executor()
+{
+  _stopping.store(true);
+  for (auto& worker : _workers)
+  {
+    worker->_sleeping.store(false);
+    std::lock_guard<std::mutex> lock(worker->_mutex);
+    worker->_wake.notify_all();
+  }
+  for (auto& worker : _workers)
+    if (worker->_thread.joinable())
+      worker->_thread.join();
+}
+
+lsp::Executor::Handle lsp::Executor::handle(unsigned source)
+{
+  return Handle{this, (_config.sticky ? static_cast<int>(source % _workers.size()) : -1)};
+}
+
+void lsp::Executor::post(Task&& task, int worker)
+{
+  if (worker >= 0)
+  {
+    Worker& target = *_workers[worker];
+    {
+      std::lock_guard<std::mutex> lock(target._mutex);
+      target._pinned.push_back(std::move(task));
+    }
+    wake(target);
+    return;
+  }
+
+  // a stage posting the next one keeps it on its own worker
+  bool local = (currentExecutor == this);
+  unsigned index = (local ? currentWorker : static_cast<unsigned>(_next.fetch_add(1) % _workers.size()));
+  Worker& target = *_workers[index];
+  size_t queued = 0;
+  {
+    std::lock_guard<std::mutex> lock(target._mutex);
+    target._tasks.push_back(std::move(task));
+    queued = target._tasks.size();
+  }
+  _stealable.fetch_add(1);
+
+  if (!local && target._sleeping.load())
+  {
+    wake(target);
+    return;
+  }
+  if (local && queued < 2)
+    return;
+
+  // there is a backlog, let an idle worker steal it
+  for (size_t i = 1; i < _workers.size(); ++i)
+  {
+    Worker& other = *_workers[(index + i) % _workers.size()];
+    if (other._sleeping.load())
+    {
+      wake(other);
+      break;
+    }
+  }
+}
+
+void lsp::Executor::wake(Worker& worker)
+{
+  if (worker._sleeping.exchange(false))
+  {
+    std::lock_guard<std::mutex> lock(worker._mutex);
+    worker._wake.notify_one();
+  }
+}
+
+lsp::Executor::Task lsp::Executor::take(unsigned index)
+{
+  Worker& worker = *_workers[index];
+  std::lock_guard<std::mutex> lock(worker._mutex);
+  Task task;
+  if (!worker._pinned.empty())
+  {
+    task = std::move(worker._pinned.front());
+    worker._pinned.pop_front();
+  }
+  else if (!worker._tasks.empty())
+  {
+    task = std::move(worker._tasks.front());
+    worker._tasks.pop_front();
+    _stealable.fetch_sub(1);
+  }
+  return task;
+}
+
+// takes the task another worker would get to last
+lsp::Executor::Task lsp::Executor::steal(unsigned index)
+{
+  Task task;
+  for (size_t i = 1; !task && i < _workers.size(); ++i)
+  {
+    Worker& victim = *_workers[(index + i) % _workers.size()];
+    std::unique_lock<std::mutex> lock(victim._mutex, std::try_to_lock);
+    if (!lock || victim._tasks.empty())
+      continue;
+    task = std::move(victim._tasks.back());
+    victim._tasks.pop_back();
+    _stealable.fetch_sub(1);
+    _workers[index]->_stolen.fetch_add(1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+void lsp::Executor::run(unsigned index)
+{
+  currentExecutor = this;
+  currentWorker = index;
+
+  if (!_config.cpus.empty())
+  {
+    int cpu = _config.cpus[index % _config.cpus.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (err)
+      spdlog::warn("{0}: worker {1} is not pinned to CPU {2}: {3}", __PRETTY_FUNCTION__, index, cpu, std::strerror(err));
+  }
+
+  Worker& worker = *_workers[index];
+  for (;;)
+  {
+    Task task = take(index);
+    if (!task)
+      task = steal(index);
+    if (task)
+    {
+      task();
+      worker._executed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(worker._mutex);
+    if (!worker._pinned.empty() || !worker._tasks.empty())
+      continue;
+    if (_stopping.load() && !_stealable.load())
+      break;
+
+    // a post either sees this worker asleep or the task is seen here
+    worker._sleeping.store(true);
+    if (_stealable.load())
+    {
+      worker._sleeping.store(false);
+      continue;
+    }
+    worker._wake.wait(lock, [this, &worker] {return !worker._sleeping.load() || _stopping.load();});
+    worker._sleeping.store(false);
+  }
+}
+
+void lsp::Executor::report() const
+{
+  size_t executed = 0;
+  size_t stolen = 0;
+  for (const auto& worker : _workers)
+  {
+    executed += worker->_executed;
+    stolen += worker->_stolen;
+  }
+  spdlog::info("executor: {0} tasks on {1} workers, {2} stolen ({3:.1f}%)"
+      , executed
+      , _workers.size()
+      , stolen
+      , (executed ? 100.0 * stolen / executed : 0.0)
+      );
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "stlab/concurrency/default_executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lsp
+{
+  // A fixed pool of workers for the pipeline stages, instead of the global
+  // pool of stlab::default_executor. Every worker has its own queue: a task
+  // posted from a worker stays on it, so a stage that feeds the next one
+  // keeps the batch in that core's cache, and a worker with nothing to do
+  // steals the newest task of another one. A sticky handle posts to a queue
+  // other workers leave alone, which keeps all the stages of one source on
+  // one worker. Workers can be pinned to CPUs.
+  struct Executor
+  {
+    struct Config
+    {
+      unsigned workers{};    // 0 is one per CPU
+      std::vector<int> cpus{}; // worker i runs on cpus[i % size], none if empty
+      bool sticky{};         // a source keeps its stages on one worker
+    };
+
+    // move-only type-erased task, stlab hands over move-only ones
+    struct Task
+    {
+      struct Concept
+      {
+	virtual ~Concept() = default;
+	virtual void run() = 0;
+      };
+
+      template<typename F>
+	struct Model final : Concept
+	{
+	  explicit Model(F&& f) : _f(std::move(f)) {}
+	  void run() override {_f();}
+	  F _f;
+	};
+
+      Task() = default;
+
+      template<typename F>
+	explicit Task(F&& f)
+	  : _self(std::make_unique<Model<std::decay_t<F>>>(std::forward<F>(f)))
+	{}
+
+      explicit operator bool() const {return static_cast<bool>(_self);}
+      void operator()() {_self->run();}
+
+      std::unique_ptr<Concept> _self{};
+    };
+
+    // what the channels are given, an empty one is stlab::default_executor
+    struct Handle
+    {
+      template<typename F>
+	void operator()(F&& f) const
+	{
+	  if (_executor)
+	    _executor->post(Task(std::forward<F>(f)), _worker);
+	  else
+	    stlab::default_executor(std::forward<F>(f));
+	}
+
+      Executor * _executor{};
+      int _worker{-1}; // sticky, -1 is any
+    };
+
+    struct Worker
+    {
+      std::mutex _mutex{};
+      std::condition_variable _wake{};
+      std::deque<Task> _tasks{};  // stolen from the back
+      std::deque<Task> _pinned{}; // never stolen
+      std::atomic_bool _sleeping{};
+      std::thread _thread{};
+      std::atomic<size_t> _executed{}; // read by report() while running
+      std::atomic<size_t> _stolen{};
+    };
+
+    explicit Executor(Config config);
+    ~Executor(); // runs what is queued, then joins
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // the stages of `source` run on these, see Config::sticky
+    Handle handle(unsigned source);
+
+    void post(Task&& task, int worker);
+    void report() const;
+
+    void run(unsigned index);
+    Task take(unsigned index);
+    Task steal(unsigned index);
+    void wake(Worker& worker);
+
+    Config _config;
+    std::vector<std::unique_ptr<Worker>> _workers{};
+    std::atomic<size_t> _stealable{}; // tasks in the _tasks queues
+    std::atomic<size_t> _next{};      // round robin of posts from other threads
+    std::atomic_bool _stopping{};
+  };
+} // lsp
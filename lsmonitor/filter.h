@@ -1,12 +1,17 @@
 #pragma once
 
 #include "function_traits.h"
+#include "debug.h"
+#include "flow.h"
 #include <type_traits>
 
 #include <stlab/concurrency/channel.hpp>
 #include <stlab/concurrency/default_executor.hpp>
 
 #include <memory>
+#include <vector>
+#include <utility>
+#include <cstdint>
 
 namespace lsp
 {
@@ -20,7 +25,7 @@ namespace lsp
       template<typename T>
       void await(T&& value)
       {
-	spdlog::debug("{0}: {1}", __PRETTY_FUNCTION__, value->filename);
+	LSP_DEBUG("{0}: {1}", __PRETTY_FUNCTION__, value->stringify());
 	if (_predicate(value))
 	{
 	  _value = std::move(value);
@@ -33,7 +38,7 @@ namespace lsp
       auto yield()
       {
 	auto value = std::move(_value);
-	spdlog::debug("{0}: {1}", __PRETTY_FUNCTION__, value->filename);
+	LSP_DEBUG("{0}: {1}", __PRETTY_FUNCTION__, value->filename);
 	_state = stlab::await_forever;
 	return value;
       }
@@ -58,6 +63,90 @@ namespace lsp
       }
     };
 
+  template<typename Predicate, typename Batch, typename = void>
+    struct selects_batch : std::false_type {};
+
+  template<typename Predicate, typename Batch>
+    struct selects_batch<Predicate, Batch, std::void_t<
+      decltype(std::declval<Predicate&>().select(std::declval<const Batch&>(), std::declval<uint64_t *>()))
+      >> : std::true_type {};
+
+  // Filters a whole batch before it is split: a predicate that can select
+  // over a batch (see CmdlExpression::select) evaluates it column-wise, any
+  // other one is called per event. The batch goes on with the events that
+  // pass, in their order. A batch with none left is dropped. The events that
+  // do not pass are released from the flow they came through, if any.
+  template <typename Batch, typename Predicate>
+    struct batch_filter
+    {
+      batch_filter() = default;
+
+      explicit batch_filter(Predicate predicate, std::shared_ptr<Flow> flow = {})
+	: _predicate(std::move(predicate))
+	, _flow(std::move(flow))
+      {}
+
+      Predicate _predicate{};
+      std::shared_ptr<Flow> _flow{};
+      Batch _batch{};
+      std::vector<uint64_t> _bits{};
+      stlab::process_state_scheduled _state = stlab::await_forever;
+
+      void await(Batch&& batch)
+      {
+	const size_t size = batch.size();
+	_bits.assign((size + 63) / 64, 0);
+	if constexpr (selects_batch<Predicate, Batch>::value)
+	  _predicate.select(batch, _bits.data());
+	else
+	  for (size_t i = 0; i < size; ++i)
+	    _bits[i / 64] |= static_cast<uint64_t>(_predicate(batch[i])) << (i % 64);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < size; ++i)
+	  if ((_bits[i / 64] >> (i % 64)) & 1)
+	  {
+	    if (kept != i)
+	      batch[kept] = std::move(batch[i]);
+	    ++kept;
+	  }
+	batch.erase(batch.begin() + kept, batch.end());
+	LSP_DEBUG("{0}: {1} of {2} events pass", __PRETTY_FUNCTION__, kept, size);
+	if (_flow && kept != size)
+	  _flow->release(size - kept);
+
+	_batch = std::move(batch);
+	_state = (_batch.empty() ? stlab::await_forever : stlab::yield_immediate);
+      }
+
+      auto yield()
+      {
+	auto batch = std::move(_batch);
+	_batch.clear();
+	_state = stlab::await_forever;
+	return batch;
+      }
+
+      auto state() const
+      {
+	return _state;
+      }
+
+      void set_error(std::exception_ptr error)
+      {
+	try
+	{
+	  if (error)
+	    std::rethrow_exception(error);
+	}
+	catch (const std::exception& e)
+	{
+	  spdlog::critical("{0} : {1}", __PRETTY_FUNCTION__, e.what());
+	  throw;
+	}
+      }
+    };
+
   template<
     typename Predicate
     , typename Value = std::remove_cv_t<
@@ -0,0 +1,94 @@
+#include "flow.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "spdlog/spdlog.h"
+
+namespace
+{
+  std::mutex flowsMutex;
+  std::vector<std::weak_ptr<lsp::Flow>> flows;
+}
+
+std::atomic_bool lsp::Flow::stopping{};
+
+lsp::Overflow lsp::parseOverflow(const std::string& name)
+{
+  if (name == "block") return Overflow::BLOCK;
+  if (name == "drop_newest") return Overflow::DROP_NEWEST;
+  if (name == "drop_oldest") return Overflow::DROP_OLDEST;
+  if (name == "sample") return Overflow::SAMPLE;
+  throw std::runtime_error(
+      fmt::format("Unknown overflow policy: '{0}', expected block, drop_newest, drop_oldest or sample", name)
+      );
+}
+
+const char * lsp::overflowName(Overflow overflow)
+{
+  switch (overflow)
+  {
+    case Overflow::BLOCK: return "block";
+    case Overflow::DROP_NEWEST: return "drop_newest";
+    case Overflow::DROP_OLDEST: return "drop_oldest";
+    case Overflow::SAMPLE: return "sample";
+  }
+  return "unknown";
+}
+
+lsp::Flow::Flow(std::string name, Config config)
+  : _name(std::move(name))
+  , _config(config)
+  , _window(config.capacity ? std::max<size_t>(1, config.capacity / 2) : std::numeric_limits<size_t>::max())
+{}
+
+lsp::Flow::~Flow() = default;
+
+void lsp::Flow::enlist(const std::shared_ptr<Flow>& flow)
+{
+  std::lock_guard<std::mutex> lock(flowsMutex);
+  flows.erase(
+      std::remove_if(flows.begin(), flows.end(), [](const auto& f) {return f.expired();})
+      , flows.end()
+      );
+  flows.push_back(flow);
+  spdlog::debug("{0}: '{1}' holds {2} events at most ({3})"
+      , __PRETTY_FUNCTION__, flow->_name, flow->_config.capacity, overflowName(flow->_config.overflow));
+}
+
+void lsp::Flow::release(size_t events)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _inFlight -= std::min(events, _inFlight);
+    pump();
+  }
+  _released.notify_all();
+}
+
+std::map<std::string, size_t> lsp::Flow::stats() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return {
+    {_name + ": received", _received}
+    , {_name + ": sent", _sent}
+    , {_name + ": dropped newest", _droppedNewest}
+    , {_name + ": dropped oldest", _droppedOldest}
+    , {_name + ": sampled out", _sampledOut}
+    , {_name + ": blocked reads", _blocked}
+    , {_name + ": blocked us", _blockedUs}
+    , {_name + ": held", held()}
+    , {_name + ": held at most", _peak}
+  };
+}
+
+std::map<std::string, size_t> lsp::Flow::statsAll()
+{
+  std::map<std::string, size_t> all;
+  std::lock_guard<std::mutex> lock(flowsMutex);
+  for (const auto& f : flows)
+    if (auto flow = f.lock())
+      all.merge(flow->stats());
+  return all;
+}
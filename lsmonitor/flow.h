@@ -0,0 +1,217 @@
+#pragma once
+
+#include "file_event/sender.h"
+
+#include "stlab/concurrency/channel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lsp
+{
+  // what a flow does with events that do not fit
+  enum class Overflow
+  {
+    BLOCK          // the reader waits, the kernel buffers (and drops) meanwhile
+    , DROP_NEWEST  // the incoming events that do not fit are dropped
+    , DROP_OLDEST  // the oldest events not sent down the pipeline yet make room
+    , SAMPLE       // an evenly spaced sample of the incoming events that fits is kept
+  };
+
+  Overflow parseOverflow(const std::string& name);
+  const char * overflowName(Overflow overflow);
+
+  // Bounds the events between a reader and the stages that are done with
+  // them. The stlab channels queue without a limit, so a flow holds the
+  // batches itself and sends them down only while at most half its capacity
+  // is in flight; the rest waits in the flow, where the overflow policy can
+  // still drop it. The stages release the events they are done with: the
+  // filter the ones it rejects, the sinks the ones they have written.
+  // Counters are exact, every event is either sent or counted as dropped.
+  struct Flow
+  {
+    struct Config
+    {
+      size_t capacity{}; // events held at most, 0 is unbounded
+      Overflow overflow{Overflow::BLOCK};
+    };
+
+    Flow(std::string name, Config config);
+    virtual ~Flow();
+
+    Flow(const Flow&) = delete;
+    Flow& operator=(const Flow&) = delete;
+
+    void release(size_t events);
+
+    // counters as `NAME: COUNTER` for printStats and the control socket
+    std::map<std::string, size_t> stats() const;
+    static std::map<std::string, size_t> statsAll(); // every flow alive
+
+    static std::atomic_bool stopping; // a blocked reader gives up waiting
+
+    std::string _name;
+    Config _config;
+    size_t _window; // events in flight at most
+
+    mutable std::mutex _mutex;
+    std::condition_variable _released;
+    size_t _pending{};  // events held, not sent yet
+    size_t _inFlight{}; // events sent, not released yet
+
+    size_t _received{};
+    size_t _sent{};
+    size_t _droppedNewest{};
+    size_t _droppedOldest{};
+    size_t _sampledOut{};
+    size_t _blocked{};   // reads that waited for room
+    size_t _blockedUs{}; // time they waited
+    size_t _peak{};      // events held at most
+
+  protected:
+    static void enlist(const std::shared_ptr<Flow>& flow);
+
+    // sends what is pending while the window has room, in order
+    virtual void pump() = 0;
+
+    size_t held() const {return _pending + _inFlight;}
+  };
+
+  template<typename Batch>
+    struct BoundedFlow final : Flow
+    {
+      BoundedFlow(std::string name, Config config, stlab::sender<Batch> send)
+	: Flow(std::move(name), config)
+	, _send(std::move(send))
+      {}
+
+      static std::shared_ptr<BoundedFlow> make(std::string name, Config config, stlab::sender<Batch> send)
+      {
+	auto flow = std::make_shared<BoundedFlow>(std::move(name), config, std::move(send));
+	enlist(flow);
+	return flow;
+      }
+
+      // called by the reader for every batch it reads
+      void admit(Batch&& batch)
+      {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_received += batch.size();
+
+	const size_t capacity = _config.capacity;
+	if (capacity && held() + batch.size() > capacity)
+	{
+	  switch (_config.overflow)
+	  {
+	    case Overflow::BLOCK:
+	      wait(lock, batch.size());
+	      break;
+	    case Overflow::DROP_OLDEST:
+	      dropOldest(held() + batch.size() - capacity);
+	      trim(batch, _droppedNewest); // all of it is in flight already
+	      break;
+	    case Overflow::DROP_NEWEST:
+	      trim(batch, _droppedNewest);
+	      break;
+	    case Overflow::SAMPLE:
+	      sample(batch);
+	      break;
+	  }
+	}
+
+	if (!batch.empty())
+	{
+	  _pending += batch.size();
+	  _batches.push_back(std::move(batch));
+	  _peak = std::max(_peak, held());
+	}
+	pump();
+      }
+
+      void wait(std::unique_lock<std::mutex>& lock, size_t size)
+      {
+	++_blocked;
+	auto start = std::chrono::steady_clock::now();
+	// a batch larger than the capacity goes alone
+	while (held() && held() + size > _config.capacity && !stopping.load())
+	  _released.wait_for(lock, std::chrono::milliseconds(100));
+	_blockedUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      }
+
+      void dropOldest(size_t excess)
+      {
+	while (excess && !_batches.empty())
+	{
+	  Batch& oldest = _batches.front();
+	  size_t dropped = std::min(excess, oldest.size());
+	  oldest.erase(oldest.begin(), oldest.begin() + dropped);
+	  if (oldest.empty())
+	    _batches.pop_front();
+	  _pending -= dropped;
+	  _droppedOldest += dropped;
+	  excess -= dropped;
+	}
+      }
+
+      // keeps the head of the batch that fits
+      void trim(Batch& batch, size_t& counter)
+      {
+	size_t room = (held() < _config.capacity ? _config.capacity - held() : 0);
+	if (batch.size() <= room)
+	  return;
+	counter += batch.size() - room;
+	batch.erase(batch.begin() + room, batch.end());
+      }
+
+      // keeps `room` events, every size/room-th one
+      void sample(Batch& batch)
+      {
+	const size_t size = batch.size();
+	size_t room = (held() < _config.capacity ? _config.capacity - held() : 0);
+	size_t kept = 0;
+	for (size_t i = 0; i < size; ++i)
+	  if ((i + 1) * room / size != i * room / size)
+	  {
+	    if (kept != i)
+	      batch[kept] = std::move(batch[i]);
+	    ++kept;
+	  }
+	batch.erase(batch.begin() + kept, batch.end());
+	_sampledOut += size - kept;
+      }
+
+      void pump() override
+      {
+	// the stlab sender only enqueues, so sending under the lock keeps the order
+	while (!_batches.empty() && (!_inFlight || _inFlight + _batches.front().size() <= _window))
+	{
+	  Batch batch = std::move(_batches.front());
+	  _batches.pop_front();
+	  _pending -= batch.size();
+	  _inFlight += batch.size();
+	  _sent += batch.size();
+	  _send(std::move(batch));
+	}
+      }
+
+      std::deque<Batch> _batches{};
+      stlab::sender<Batch> _send;
+    };
+
+  // what the reader gets to send its batches through the flow
+  template<typename Batch>
+    lsp::Sender<Batch> sender(std::shared_ptr<BoundedFlow<Batch>> flow)
+    {
+      return [flow = std::move(flow)](Batch batch) {flow->admit(std::move(batch));};
+    }
+
+} // lsp
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "debug.h"
+#include "lspredicate/event_traits.hpp"
+
+#include <stlab/concurrency/channel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace lsp
+{
+  // what the joins compare filenames by: the interned symbol, or a hash
+  // where the interner had no room (symbols leave the top bit clear, hashes
+  // have it set)
+  template<typename E>
+    uint64_t filename_key(const E& event)
+    {
+      using traits = lsp::predicate::event_traits<E>;
+      uint64_t symbol = traits::filename_symbol(event);
+      return (symbol ? symbol : (std::hash<std::string_view>{}(traits::filename(event)) | (uint64_t(1) << 63)));
+    }
+
+  // Joins two streams of events on (pid, filename) over a time window. An
+  // event is matched against the oldest unmatched event of the other side
+  // with the same key that arrived within the window; one that finds none
+  // waits in the window for a match. MATCHED emits the pairs found,
+  // UNMATCHED the events that leave the window without a match.
+  //
+  // Each side keeps its events in arrival order, which is the order they
+  // expire in. A hash index on the key points to the oldest unmatched event
+  // of the key, the others are chained through the slots, so matching and
+  // expiry are O(1). A matched event leaves a hole that is dropped once it
+  // reaches the front. A side holds at most `capacity` slots, beyond that
+  // the oldest leaves early, as if it had expired.
+  template<typename L, typename R>
+    struct window_join
+    {
+      enum class Emit
+      {
+	MATCHED
+	, UNMATCHED
+      };
+
+      using clock = std::chrono::steady_clock;
+      using value_type = std::variant<L, R>;
+      using input_type = std::variant<std::vector<L>, std::vector<R>>;
+      using output_type = std::vector<value_type>;
+
+      struct Key
+      {
+	long pid{};
+	uint64_t file{};
+
+	bool operator==(const Key& other) const {return pid == other.pid && file == other.file;}
+      };
+
+      struct KeyHash
+      {
+	size_t operator()(const Key& key) const
+	{
+	  return std::hash<uint64_t>{}(key.file * 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(key.pid));
+	}
+      };
+
+      static constexpr uint64_t none = ~uint64_t(0);
+
+      struct Slot
+      {
+	Key key{};
+	clock::time_point arrived{};
+	uint64_t next{none}; // the next event of the key
+	value_type event{};
+	bool live{};
+      };
+
+      struct Chain
+      {
+	uint64_t head{}; // oldest unmatched, sequence numbers
+	uint64_t tail{};
+      };
+
+      struct Side
+      {
+	std::deque<Slot> slots{};
+	uint64_t base{}; // sequence of slots.front()
+	std::unordered_map<Key, Chain, KeyHash> index{};
+      };
+
+      Emit _emit{Emit::MATCHED};
+      std::chrono::nanoseconds _window{};
+      size_t _capacity{};
+      Side _sides[2]{};
+      output_type _out{};
+      stlab::process_state_scheduled _state = stlab::await_forever;
+
+      window_join(Emit emit, std::chrono::nanoseconds window, size_t capacity)
+	: _emit(emit)
+	, _window(window)
+	, _capacity(std::max<size_t>(1, capacity))
+      {}
+
+      template<typename E>
+	static Key key(const E& event)
+	{
+	  return {lsp::predicate::event_traits<E>::pid(event), filename_key(event)};
+	}
+
+      void await(input_type&& input)
+      {
+	auto now = clock::now();
+	if (input.index() == 0)
+	  for (auto& event : std::get<0>(input))
+	    arrive<0>(std::move(event), now);
+	else
+	  for (auto& event : std::get<1>(input))
+	    arrive<1>(std::move(event), now);
+	expire(now);
+	schedule(now);
+      }
+
+      template<size_t I, typename E>
+	void arrive(E&& event, clock::time_point now)
+	{
+	  Key k = key(event);
+
+	  Side& other = _sides[1 - I];
+	  auto it = other.index.find(k);
+	  if (it != other.index.end())
+	  {
+	    Slot& slot = other.slots[it->second.head - other.base];
+	    value_type matched = std::move(slot.event);
+	    unlink(other, it, slot);
+	    LSP_DEBUG("{0}: {1} matched", __PRETTY_FUNCTION__, event->filename);
+	    if (_emit == Emit::MATCHED)
+	    {
+	      _out.push_back(std::move(matched));
+	      _out.emplace_back(std::in_place_index<I>, std::forward<E>(event));
+	    }
+	    return;
+	  }
+
+	  Side& side = _sides[I];
+	  if (side.slots.size() >= _capacity)
+	    popFront(side);
+
+	  uint64_t seq = side.base + side.slots.size();
+	  side.slots.push_back(Slot{k, now, none, value_type(std::in_place_index<I>, std::forward<E>(event)), true});
+	  auto [chain, inserted] = side.index.try_emplace(k, Chain{seq, seq});
+	  if (!inserted)
+	  {
+	    side.slots[chain->second.tail - side.base].next = seq;
+	    chain->second.tail = seq;
+	  }
+	}
+
+      // the slot is the head of its chain
+      void unlink(Side& side, typename std::unordered_map<Key, Chain, KeyHash>::iterator it, Slot& slot)
+      {
+	slot.live = false;
+	if (slot.next == none)
+	  side.index.erase(it);
+	else
+	  it->second.head = slot.next;
+      }
+
+      // the oldest unmatched event is the oldest of its key too
+      void popFront(Side& side)
+      {
+	Slot& front = side.slots.front();
+	if (front.live)
+	{
+	  unlink(side, side.index.find(front.key), front);
+	  if (_emit == Emit::UNMATCHED)
+	    _out.push_back(std::move(front.event));
+	}
+	side.slots.pop_front();
+	++side.base;
+      }
+
+      void expire(clock::time_point now)
+      {
+	for (Side& side : _sides)
+	  while (!side.slots.empty() && side.slots.front().arrived + _window <= now)
+	    popFront(side);
+      }
+
+      void schedule(clock::time_point now)
+      {
+	if (!_out.empty())
+	{
+	  _state = stlab::yield_immediate;
+	  return;
+	}
+
+	bool waiting = false;
+	clock::time_point earliest = clock::time_point::max();
+	for (const Side& side : _sides)
+	  if (!side.slots.empty())
+	  {
+	    waiting = true;
+	    earliest = std::min(earliest, side.slots.front().arrived);
+	  }
+
+	if (!waiting)
+	  _state = stlab::await_forever;
+	else if (earliest + _window <= now)
+	  _state = stlab::yield_immediate;
+	else // stlab calls yield() if nothing arrives until then
+	  _state = stlab::process_state_scheduled{stlab::process_state::await, earliest + _window - now};
+      }
+
+      // may be empty, when the timer found nothing to emit
+      output_type yield()
+      {
+	auto now = clock::now();
+	expire(now);
+	output_type out = std::move(_out);
+	_out.clear();
+	schedule(now);
+	return out;
+      }
+
+      auto state() const
+      {
+	return _state;
+      }
+
+      void set_error(std::exception_ptr error)
+      {
+	try
+	{
+	  if (error)
+	    std::rethrow_exception(error);
+	}
+	catch (const std::exception& e)
+	{
+	  spdlog::critical("{0} : {1}", __PRETTY_FUNCTION__, e.what());
+	  throw;
+	}
+      }
+    };
+} // lsp
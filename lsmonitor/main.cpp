@@ -1,9 +1,13 @@
 #include "spdlog/spdlog.h"
 #include "argh.h"
 
-//#include "control_reader.h"
+#include "control_reader.h"
 #include "lspredicate/cmdl_expression.h"
+#include "lspredicate/rule_set.h"
+#include "lspredicate/hot_swap.h"
+#include "lspredicate/interner.hpp"
 #include "source_manager.h"
+#include "process_cache.h"
 
 #include <signal.h>
 #include <errno.h>
@@ -13,9 +17,15 @@
 #include <unistd.h>
 #include <stdexcept>
 #include <atomic>
+#include <memory>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <type_traits>
 
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <system_error>
 
 #include "stlab/concurrency/channel.hpp"
@@ -47,13 +57,92 @@ void signal_handler(int sig, siginfo_t *, void *)
   if (sig == SIGTERM || sig == SIGINT)
   {
     lsp::Reader::stopping.store(true);
+    lsp::ReplayReader::stopping.store(true);
+    lsp::SyntheticReader::stopping.store(true);
     fan::Reader::stopping.store(true);
     ctl::broadcast::stopping.store(true);
-    // ctl::Reader::stopping.store(true);
+    ctl::Reader::stopping.store(true);
+    lsp::Flow::stopping.store(true);
     release_probe();
   }
 }
 
+// what 'stats' on the control socket answers
+std::map<std::string, size_t> runtime_stats()
+{
+  auto stats = lsp::Flow::statsAll();
+  stats.merge(lsp::EventPool<fan::FileEvent>::instance().stats("fanotify"));
+  stats.merge(lsp::EventPool<lsp::FileEvent>::instance().stats("lsprobe"));
+  return stats;
+}
+
+// Compiles a predicate sent to the control socket and publishes it to the
+// running filter stages. Runs on the executor, off the filter stages.
+template<typename Predicate>
+void handle_control(const lsp::predicate::HotSwap<Predicate>& predicate, const ctl::ControlEvent& event)
+{
+  constexpr bool rules = std::is_same_v<Predicate, lsp::predicate::RuleSet>;
+  if (event.uid != 0 && event.uid != ::geteuid())
+  {
+    spdlog::warn("Control command from {0} [{1}] uid {2} is denied", event.process, event.pid, event.uid);
+    event.reply("error: permission denied\n");
+    return;
+  }
+  if (event.code == ctl::EventCode::STATS)
+  {
+    std::string text;
+    for (const auto& s : runtime_stats())
+      text += fmt::format("{0}: {1}\n", s.first, s.second);
+    event.reply(text);
+    return;
+  }
+  if (event.code != (rules ? ctl::EventCode::RULES : ctl::EventCode::EXPR))
+  {
+    event.reply(fmt::format("error: expected '{0}' or 'stats'\n", (rules ? "rules FILE" : "expr EXPRESSION")));
+    return;
+  }
+
+  try
+  {
+    auto start = std::chrono::steady_clock::now();
+    Predicate compiled(event.argument);
+    auto compiledIn = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    if constexpr (rules)
+      compiled.report();
+
+    uint64_t generation = predicate.publish(std::move(compiled));
+    spdlog::info("Predicate #{0} from {1} [{2}] compiled in {3} us: {4}"
+	, generation, event.process, event.pid, compiledIn.count(), event.argument);
+    event.reply(fmt::format("ok: predicate #{0} compiled in {1} us\n", generation, compiledIn.count()));
+  }
+  catch (const std::exception& e)
+  {
+    spdlog::warn("Predicate from {0} [{1}] is rejected: {2}", event.process, event.pid, e.what());
+    event.reply(fmt::format("error: {0}\n", e.what()));
+  }
+}
+
+// serves the control socket until it is stopped
+template<typename Predicate>
+void control(lsp::predicate::HotSwap<Predicate> predicate)
+{
+  auto channel = stlab::channel<ctl::Reader::event_t>(stlab::default_executor);
+  auto r = channel.second
+    | [predicate](ctl::Reader::event_t event) {handle_control(predicate, *event);};
+  channel.second.set_ready();
+
+  try
+  {
+    ctl::Reader reader;
+    spdlog::info("Accepting predicates on '{0}'...", reader._path.native());
+    reader(std::move(channel.first));
+  }
+  catch (const std::exception& e)
+  {
+    spdlog::error("Control socket is unavailable: {0}", e.what());
+  }
+}
+
 void setup_signal_handler()
 {
   struct sigaction sa;
@@ -80,14 +169,50 @@ void print_usage(const char * argv0)
     << "\t-d, --debug .................... Enable debug messages\n"
     << "\t-h, --help ..................... This message\n"
     << "\t--fanotify ..................... Use fanotify(7) facility as a source (for testing purposes)\n"
+    << "\t                                 on the mount of /home, only for the event types an --expr accepts\n"
+    << "\t--fid ......................... Let fanotify(7) report file handles instead of opening files, if supported\n"
     << "\t--lsprobe ...................... Use /sys/kernel/security/lsprobe/events as a source (default)\n"
+    << "\t--batch=N ...................... Read up to N lsprobe events per syscall and pass up to N\n"
+    << "\t                                 events at once between the stages (default: 1)\n"
+    << "\t--batch_latency=US ............. Pass a batch that is not full after US microseconds (default: 1000)\n"
+    << "\t--io_uring=N ................... Read all sources on one thread with io_uring(7), N fanotify reads in\n"
+    << "\t                                 flight, one lsprobe read as its records may span reads\n"
+    << "\t--workers=N .................... Run the stages on N workers of their own instead of the shared pool,\n"
+    << "\t                                 0 is one per CPU\n"
+    << "\t  --cpus=LIST ................... Pin the workers to CPUs, e.g. 0,2,4-7\n"
+    << "\t  --sticky ...................... Keep the stages of a source on one worker\n"
+    << "\t--queue=N ...................... Hold up to N events per source in the pipeline (default: 0, unbounded)\n"
+    << "\t--overflow=POLICY .............. What to do with events beyond --queue: block the reader (default),\n"
+    << "\t                                 drop_newest, drop_oldest, or sample the incoming ones\n"
+    << "\t--capture=FILE ................. Append raw lsprobe events to FILE\n"
+    << "\t--replay=FILE .................. Replay events captured in FILE instead of reading lsprobe\n"
+    << "\t--speed=N ...................... Replay at N times the captured pace, 0 is as fast as possible (default: 1)\n"
+    << "\t--synthetic .................... Generate events instead of reading lsprobe (for load testing),\n"
+    << "\t                                 in batches of --batch events (default: 64):\n"
+    << "\t  --rate=N ..................... Events per second, 0 is as fast as possible (default: 0)\n"
+    << "\t  --events=N ................... Stop after N events (default: run until stopped)\n"
+    << "\t  --paths=N .................... Distinct file paths (default: 4096)\n"
+    << "\t  --path_len=MEAN[:STDDEV] ..... Normal distribution of path lengths (default: 48:16)\n"
+    << "\t  --processes=N ................ Distinct process names (default: 64)\n"
+    << "\t  --pids=N ..................... Distinct pids (default: 256)\n"
+    << "\t  --codes=CODE:WEIGHT,... ...... Mix of event codes (default: 1:1)\n"
     << "\n"
     << "Modes:\n"
     << "\t--only ......................... Use the only source (default)\n"
     << "\t--any .......................... Use all sources in parallel\n"
     << "\t--count_stringified ............ Use all sources and merge them stringified\n"
-//     << "\t--intersection.................. Use all sources and show only events that came from all sources simultaneosly\n"
-//    << "\t--difference ................... Use all sources and show only events that came from the only sources\n"
+    << "\t  --group_by=FIELDS ............. Count events per distinct FIELDS, of process, pid, uid, gid, code and\n"
+    << "\t                                 file (default: process,uid,code,file)\n"
+    << "\t  --max_keys=N .................. Distinct keys counted at most, the events of others are counted as\n"
+    << "\t                                 overflow (default: 65536)\n"
+    << "\t--intersection ................. Use all sources and show only events that came from both of them\n"
+    << "\t--difference ................... Use all sources and show only events that came from one of them\n"
+    << "\t  --window=MS ................... How long an event waits for the same pid and file from the other\n"
+    << "\t                                 source (default: 100)\n"
+    << "\t  --window_events=N ............. Events per source in the window at most (default: 65536)\n"
+    << "\t--buffered_difference .......... Use all sources and show only files that one of them saw, the window\n"
+    << "\t                                 starts at --window and follows the lag between the sources\n"
+    << "\t  --buffer=N .................... Events per source in the window at most (default: 4096)\n"
     << "\n"
     << "Predicate:\n"
     << "\t--expr='EXPRESSION' ............ Expression in a form:\n"
@@ -100,9 +225,91 @@ void print_usage(const char * argv0)
     << "\t    pid ........................ Process id\n"
     << "\t    uid ........................ User id\n"
     << "\t    gid ........................ Group id\n"
+    << "\n"
+    << "\t  and operators:\n"
+    << "\t    ==, != ..................... Equality\n"
+    << "\t    =~ ......................... Glob match of file or process: '*' within a path\n"
+    << "\t                                 component, '**' across them, '?', [a-z], [!a-z]\n"
+    << "\t    ^= ......................... Prefix of file or process\n"
+    << "\t    contains ................... Substring of file or process\n"
+    << "\t    in [A, B, ...] ............. Membership in a set of numbers or strings\n"
+    << "\t    in @FILE ................... Membership in a set read from FILE, an entry per line\n"
+    << "\n"
+    << "\t--rules=FILE ................... Rules in a form 'NAME: EXPRESSION', a rule per line,\n"
+    << "\t                                 an event passes if any of them matches (instead of --expr)\n"
+    << "\t--ctl .......................... Accept 'expr EXPRESSION' (or 'rules FILE' with --rules)\n"
+    << "\t                                 on /var/run/lsmonitor/ctl to replace the predicate while\n"
+    << "\t                                 running; fanotify marks are not narrowed by the predicate then.\n"
+    << "\t                                 'stats' answers the queue and event pool counters\n"
     << std::endl;
 }
 
+// no --workers keeps stlab::default_executor
+std::unique_ptr<lsp::Executor> make_executor(const argh::parser& cmdl)
+{
+  if (!cmdl("--workers"))
+    return {};
+
+  lsp::Executor::Config config;
+  cmdl("--workers", 0) >> config.workers;
+  config.sticky = cmdl["--sticky"];
+
+  // CPU[-CPU][,CPU[-CPU]...]
+  std::istringstream in(cmdl("--cpus").str());
+  std::string item;
+  while (std::getline(in, item, ','))
+  {
+    int first = 0;
+    int last = 0;
+    int parsed = std::sscanf(item.c_str(), "%d-%d", &first, &last);
+    if (parsed < 1 || first < 0 || (parsed == 2 && last < first))
+      throw std::runtime_error(fmt::format("Invalid CPU list: '{0}'", cmdl("--cpus").str()));
+    for (int cpu = first; cpu <= (parsed == 2 ? last : first); ++cpu)
+      config.cpus.push_back(cpu);
+  }
+  return std::make_unique<lsp::Executor>(std::move(config));
+}
+
+lsp::SyntheticReader::Config synthetic_config(const argh::parser& cmdl)
+{
+  lsp::SyntheticReader::Config config;
+  cmdl("--batch", config.batch) >> config.batch;
+  cmdl("--rate", config.rate) >> config.rate;
+  cmdl("--events", config.events) >> config.events;
+  cmdl("--paths", config.paths) >> config.paths;
+  cmdl("--processes", config.processes) >> config.processes;
+  cmdl("--pids", config.pids) >> config.pids;
+
+  // MEAN[:STDDEV]
+  std::string pathLength = cmdl("--path_len").str();
+  if (!pathLength.empty())
+  {
+    char separator = 0;
+    std::istringstream in(pathLength);
+    in >> config.pathLengthMean;
+    if (in >> separator >> config.pathLengthStddev && separator != ':')
+      throw std::runtime_error(fmt::format("Invalid path length distribution: '{0}'", pathLength));
+  }
+
+  // CODE:WEIGHT[,CODE:WEIGHT...]
+  std::string codes = cmdl("--codes").str();
+  if (!codes.empty())
+  {
+    config.codes.clear();
+    std::istringstream in(codes);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+      long code = 0;
+      double weight = 1.0;
+      if (std::sscanf(item.c_str(), "%ld:%lf", &code, &weight) < 1)
+	throw std::runtime_error(fmt::format("Invalid event code weight: '{0}'", item));
+      config.codes.emplace_back(code, weight);
+    }
+  }
+  return config;
+}
+
 int main(int argc, char ** argv)
 {
   argh::parser cmdl;
@@ -116,6 +323,28 @@ int main(int argc, char ** argv)
       , "process"
       , "expr"
       , "buffer"
+      , "batch"
+      , "batch_latency"
+      , "io_uring"
+      , "workers"
+      , "cpus"
+      , "queue"
+      , "window"
+      , "window_events"
+      , "overflow"
+      , "group_by"
+      , "max_keys"
+      , "capture"
+      , "replay"
+      , "speed"
+      , "rate"
+      , "events"
+      , "paths"
+      , "path_len"
+      , "processes"
+      , "pids"
+      , "codes"
+      , "rules"
       });
   cmdl.parse(argc, argv);
 
@@ -135,45 +364,148 @@ int main(int argc, char ** argv)
 
   setup_signal_handler();
 
-  SourceManager manager;
+  size_t batch = 1;
+  cmdl("--batch", 1) >> batch;
+
+  unsigned uringDepth = 0;
+  cmdl("--io_uring", 0) >> uringDepth;
 
-  if (cmdl["--any"])
+  unsigned batchLatency = 1000;
+  cmdl("--batch_latency", 1000) >> batchLatency;
+
+  lsp::Flow::Config flow;
+  cmdl("--queue", 0) >> flow.capacity;
+  std::string overflow = cmdl("--overflow").str();
+  if (!overflow.empty())
+    flow.overflow = lsp::parseOverflow(overflow);
+
+  std::unique_ptr<lsp::Executor> executor = make_executor(cmdl);
+
+  unsigned window = 100;
+  cmdl("--window", 100) >> window;
+  size_t windowEvents = 65536;
+  cmdl("--window_events", 65536) >> windowEvents;
+
+  lsp::Aggregate::Config aggregate;
+  std::string groupBy = cmdl("--group_by").str();
+  if (!groupBy.empty())
+    aggregate.groupBy = lsp::parseGroupBy(groupBy);
+  cmdl("--max_keys", aggregate.maxKeys) >> aggregate.maxKeys;
+
+  SourceManager manager{
+    uringDepth
+    , batch
+    , std::chrono::microseconds(batchLatency)
+    , flow
+    , executor.get()
+    , std::chrono::milliseconds(window)
+    , windowEvents
+    , aggregate
+  };
+
+  fan::Reader::Mode fan_mode = (cmdl["--fid"] ? fan::Reader::Mode::FID : fan::Reader::Mode::FD);
+
+  auto dispatch = [&cmdl, &manager, fan_mode](auto&& lsp_reader, auto&& predicate)
   {
-    spdlog::info("Starting in 'any' mode...");
-    manager.any(lsp::Reader{}, fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
-  }
-  else if (cmdl["--count_stringified"])
+    if (cmdl["--any"])
+    {
+      spdlog::info("Starting in 'any' mode...");
+      manager.any(std::move(lsp_reader), fan::Reader{fan_mode}, std::move(predicate));
+    }
+    else if (cmdl["--count_stringified"])
+    {
+      spdlog::info("Starting in 'count_stringified' mode...");
+      manager.count_stringified(std::move(lsp_reader), fan::Reader{fan_mode}, std::move(predicate));
+    }
+    else if (cmdl["--intersection"])
+    {
+      spdlog::info("Starting in 'intersection' mode...");
+      manager.intersection(std::move(lsp_reader), fan::Reader{fan_mode}, std::move(predicate));
+    }
+    else if (cmdl["--difference"])
+    {
+      spdlog::info("Starting in 'difference' mode...");
+      manager.difference(std::move(lsp_reader), fan::Reader{fan_mode}, std::move(predicate));
+    }
+    else if (cmdl["--buffered_difference"])
+    {
+      spdlog::info("Starting in 'buffered_difference' mode...");
+      size_t buffer_size = 4096;
+      cmdl("--buffer", 4096) >> buffer_size;
+      manager.buffered_difference(std::move(lsp_reader), fan::Reader{fan_mode}, std::move(predicate), buffer_size);
+    }
+    else if (cmdl["--fanotify"])
+    {
+      spdlog::info("Starting fanotify listening...");
+      manager.only(fan::Reader{fan_mode}, std::move(predicate));
+    }
+    else
+    {
+      spdlog::info("Starting lsprobe listening...");
+      manager.only(std::move(lsp_reader), std::move(predicate));
+    }
+  };
+
+  // with --ctl the predicate can be replaced through the control socket
+  auto run = [&cmdl, &dispatch](auto&& lsp_reader, auto&& predicate)
+  {
+    using predicate_t = std::decay_t<decltype(predicate)>;
+    if (!cmdl["--ctl"])
+    {
+      dispatch(std::move(lsp_reader), std::move(predicate));
+      return;
+    }
+
+    lsp::predicate::HotSwap<predicate_t> swappable(std::move(predicate));
+    std::thread control_thread(control<predicate_t>, swappable);
+    dispatch(std::move(lsp_reader), std::move(swappable));
+    ctl::Reader::stopping.store(true);
+    control_thread.join();
+  };
+
+  std::string rules = cmdl("--rules").str();
+  auto start = [&cmdl, &run, &rules](auto&& lsp_reader)
+  {
+    if (!rules.empty())
+    {
+      lsp::predicate::RuleSet predicate(rules);
+      predicate.report();
+      run(std::move(lsp_reader), std::move(predicate));
+    }
+    else
+      run(std::move(lsp_reader), lsp::predicate::CmdlExpression(cmdl("--expr").str()));
+  };
+
+  std::string replay = cmdl("--replay").str();
+  if (cmdl["--synthetic"])
   {
-    spdlog::info("Starting in 'count_stringified' mode...");
-    manager.count_stringified(lsp::Reader{}, fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
+    spdlog::info("Generating synthetic events instead of lsprobe...");
+    start(lsp::SyntheticReader{synthetic_config(cmdl)});
   }
-//   else if (cmdl["--intersection"])
-//   {
-//     spdlog::info("Starting in 'intersection' mode...");
-//     manager.intersection(lsp::Reader{}, fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
-//   }
-//   else if (cmdl["--difference"])
-//   {
-//     spdlog::info("Starting in 'difference' mode...");
-//     manager.difference(lsp::Reader{}, fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
-//   }
-//   else if (cmdl["--buffered_difference"])
-//   {
-//     spdlog::info("Starting in 'buffered_difference' mode...");
-//     size_t buffer_size = 3;
-//     cmdl("--buffer", 3) >> buffer_size;
-//     manager.buffered_difference(lsp::Reader{}, fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()), buffer_size);
-//   }
-  else if (cmdl["--fanotify"])
+  else if (!replay.empty())
   {
-    spdlog::info("Starting fanotify listening...");
-    manager.only(fan::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
+    double speed = 1.0;
+    cmdl("--speed", 1.0) >> speed;
+    spdlog::info("Replaying '{0}' instead of lsprobe...", replay);
+    start(lsp::ReplayReader{replay, speed, batch});
   }
   else
   {
-    spdlog::info("Starting lsprobe listening...");
-    manager.only(lsp::Reader{}, lsp::predicate::CmdlExpression(cmdl("--expr").str()));
+    lsp::Reader reader{batch};
+    std::string capture = cmdl("--capture").str();
+    if (!capture.empty())
+    {
+      spdlog::info("Capturing lsprobe events to '{0}'...", capture);
+      reader.capture(capture);
+    }
+    start(std::move(reader));
   }
 
+  if (executor)
+    executor->report();
+  linux::ProcessCache::instance().report();
+  lspredicate::interner::instance().report();
+  lsp::EventPool<fan::FileEvent>::instance().report("fanotify");
+  lsp::EventPool<lsp::FileEvent>::instance().report("lsprobe");
   return 0;
 }
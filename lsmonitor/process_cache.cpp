@@ -0,0 +1,273 @@
+#include "process_cache.h"
+
+#include "spdlog/spdlog.h"
+#include "fmt/format.h"
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+  // how long an entry is used before /proc is read again: bounds how stale
+  // the comm is after an exec and the pgid after setpgid() or setsid(), and
+  // tells a reused pid apart by its start time when exits cannot be watched
+  constexpr auto refreshPeriod = std::chrono::milliseconds(100);
+
+  // how often the exits are collected from the pidfds, one epoll_wait per
+  // slice instead of one per lookup
+  constexpr auto reapPeriod = std::chrono::milliseconds(10);
+
+  // the share of the open file limit the pidfds may take, the rest is left
+  // to the readers, e.g. the fds of fanotify events
+  constexpr size_t pidfdShare = 4;
+
+  int pidfd_open(pid_t pid)
+  {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+}
+
+linux::ProcessCache::ProcessCache(size_t capacity)
+  : _capacity(std::max<size_t>(1, capacity))
+{
+  _epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+  int probe = pidfd_open(::getpid());
+  _pidfds = (_epollFd != -1 && probe != -1);
+  if (probe != -1)
+    ::close(probe);
+  if (!_pidfds)
+  {
+    spdlog::debug("{0}: pidfd is not available, entries are checked every {1}ms"
+	, __PRETTY_FUNCTION__, refreshPeriod.count());
+    return;
+  }
+
+  // every entry holds a pidfd
+  struct rlimit limit{};
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+  {
+    size_t fds = std::max<size_t>(16, limit.rlim_cur / pidfdShare);
+    if (fds < _capacity)
+    {
+      spdlog::debug("{0}: {1} entries at most, a {2}th of the open file limit"
+	  , __PRETTY_FUNCTION__, fds, pidfdShare);
+      _capacity = fds;
+    }
+  }
+}
+
+linux::ProcessCache::~ProcessCache()
+{
+  for (auto& entry : _entries)
+    if (entry.second.pidfd != -1)
+      ::close(entry.second.pidfd);
+  if (_epollFd != -1)
+    ::close(_epollFd);
+}
+
+linux::ProcessCache& linux::ProcessCache::instance()
+{
+  static ProcessCache cache;
+  return cache;
+}
+
+std::string linux::ProcessCache::comm(pid_t pid)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Entry * entry = lookup(pid);
+  return (entry ? entry->comm : std::string("no_process"));
+}
+
+pid_t linux::ProcessCache::pgid(pid_t pid)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Entry * entry = lookup(pid);
+  return (entry ? entry->pgid : -1);
+}
+
+pid_t linux::ProcessCache::info(pid_t pid, std::string& comm)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Entry * entry = lookup(pid);
+  if (!entry)
+  {
+    comm.assign("no_process");
+    return -1;
+  }
+  comm.assign(entry->comm);
+  return entry->pgid;
+}
+
+void linux::ProcessCache::report() const
+{
+  size_t hits = _hits.load();
+  size_t misses = _misses.load();
+  spdlog::info("process cache: {0} hits, {1} misses ({2:.1f}% hit rate), {3} refreshed, {4} evictions"
+      , hits
+      , misses
+      , (hits + misses ? 100.0 * hits / (hits + misses) : 0.0)
+      , _refreshes.load()
+      , _evictions.load()
+      );
+}
+
+// must be called under the lock
+const linux::ProcessCache::Entry * linux::ProcessCache::lookup(pid_t pid)
+{
+  // a pid is reused only after its process exited, which its pidfd shows;
+  // an exit is noticed within a reap period, reuse takes a pid wraparound
+  auto now = std::chrono::steady_clock::now();
+  if (now - _reaped >= reapPeriod)
+  {
+    _reaped = now;
+    reap();
+  }
+
+  auto it = _entries.find(pid);
+  if (it != _entries.end())
+  {
+    Entry& entry = it->second;
+    if (now - entry.filled < refreshPeriod)
+    {
+      ++_hits;
+      return &entry;
+    }
+
+    Entry fresh;
+    if (readStat(pid, fresh) && fresh.startTime == entry.startTime)
+    {
+      ++_refreshes;
+      entry.comm = std::move(fresh.comm);
+      entry.pgid = fresh.pgid;
+      entry.filled = fresh.filled;
+      return &entry;
+    }
+    evict(pid); // exited, or the pid is another process now
+  }
+
+  ++_misses;
+  Entry entry;
+  if (!fill(pid, entry))
+    return nullptr;
+
+  if (_entries.size() >= _capacity && !_order.empty())
+    evict(_order.front());
+
+  entry.order = _order.insert(_order.end(), pid);
+  return &(_entries[pid] = std::move(entry));
+}
+
+bool linux::ProcessCache::fill(pid_t pid, Entry& entry) const
+{
+  // the pidfd goes first: if the process dies after it is opened, the exit
+  // shows up on the pidfd instead of going unnoticed
+  if (_pidfds)
+  {
+    entry.pidfd = pidfd_open(pid);
+    if (entry.pidfd == -1)
+      return false;
+  }
+
+  if (!readStat(pid, entry))
+  {
+    if (entry.pidfd != -1)
+      ::close(entry.pidfd);
+    return false;
+  }
+
+  if (entry.pidfd != -1)
+  {
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = (static_cast<uint64_t>(entry.startTime) << 32) | static_cast<uint32_t>(pid);
+    ::epoll_ctl(_epollFd, EPOLL_CTL_ADD, entry.pidfd, &event);
+  }
+  return true;
+}
+
+bool linux::ProcessCache::readStat(pid_t pid, Entry& entry)
+{
+  // one read of /proc/PID/stat gives the comm, the process group and the start time
+  char buffer[1024];
+  int fd = ::open(fmt::format("/proc/{0}/stat", pid).c_str(), O_RDONLY | O_CLOEXEC);
+  ssize_t size = (fd != -1 ? ::read(fd, buffer, sizeof(buffer) - 1) : -1);
+  if (fd != -1)
+    ::close(fd);
+
+  const char * open = (size > 0 ? static_cast<const char *>(std::memchr(buffer, '(', size)) : nullptr);
+  const char * close = nullptr;
+  if (open)
+  {
+    buffer[size] = 0;
+    close = std::strrchr(open, ')'); // comm itself may contain ')'
+  }
+
+  // fields after the comm: state ppid pgrp ... with starttime being the 20th of them
+  int parsed = 0;
+  if (close)
+  {
+    char state = 0;
+    int ppid = 0;
+    int pgrp = 0;
+    parsed = std::sscanf(close + 1
+	, " %c %d %d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu"
+	, &state, &ppid, &pgrp, &entry.startTime
+	);
+    entry.pgid = pgrp;
+  }
+
+  if (parsed != 4)
+    return false;
+
+  entry.comm.assign(open + 1, close);
+  entry.filled = std::chrono::steady_clock::now();
+  return true;
+}
+
+void linux::ProcessCache::evict(pid_t pid)
+{
+  auto it = _entries.find(pid);
+  if (it == _entries.end())
+    return;
+  if (it->second.pidfd != -1)
+    ::close(it->second.pidfd); // also drops it from the epoll set
+  _order.erase(it->second.order);
+  _entries.erase(it);
+  ++_evictions;
+}
+
+void linux::ProcessCache::reap()
+{
+  if (!_pidfds)
+    return;
+
+  struct epoll_event events[64];
+  int count = 0;
+  while ((count = ::epoll_wait(_epollFd, events, std::size(events), 0)) > 0)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      pid_t pid = static_cast<pid_t>(events[i].data.u64 & 0xffffffff);
+      unsigned long long startTime = events[i].data.u64 >> 32;
+      auto it = _entries.find(pid);
+      if (it != _entries.end() && (it->second.startTime & 0xffffffff) == startTime)
+	evict(pid);
+    }
+    if (count < static_cast<int>(std::size(events)))
+      break;
+  }
+}
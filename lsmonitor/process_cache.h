@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <utility>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sys/types.h>
+
+namespace linux
+{
+  // Per-process metadata read from /proc and kept until the process exits.
+  // Exits are noticed through pidfds where the kernel has them. An entry is
+  // read again when it is older than a short period: the comm changes on
+  // exec and the pgid on setpgid(), and without pidfds the start time tells
+  // a reused pid apart. Each entry holds a pidfd, so the capacity is kept
+  // well below the open file limit.
+  struct ProcessCache
+  {
+    struct Entry
+    {
+      unsigned long long startTime{}; // in clock ticks since boot, tells reused pids apart
+      std::string comm{};
+      pid_t pgid{-1};
+      int pidfd{-1};
+      std::chrono::steady_clock::time_point filled{};
+      std::list<pid_t>::iterator order{}; // its place in _order
+    };
+
+    explicit ProcessCache(size_t capacity = 4096);
+
+    ProcessCache(const ProcessCache&) = delete;
+    ProcessCache& operator=(const ProcessCache&) = delete;
+
+    ~ProcessCache();
+
+    static ProcessCache& instance();
+
+    std::string comm(pid_t pid);
+    pid_t pgid(pid_t pid);
+    pid_t info(pid_t pid, std::string& comm); // both under one lookup, comm keeps its buffer
+
+    void report() const;
+
+    const Entry * lookup(pid_t pid);
+    bool fill(pid_t pid, Entry& entry) const;
+    static bool readStat(pid_t pid, Entry& entry); // comm, pgid and start time
+    void evict(pid_t pid);
+    void reap();
+
+    size_t _capacity{};
+    int _epollFd{-1};
+    bool _pidfds{};
+    std::chrono::steady_clock::time_point _reaped{};
+
+    std::mutex _mutex{};
+    std::unordered_map<pid_t, Entry> _entries{};
+    std::list<pid_t> _order{}; // insertion order for capacity eviction, only live entries
+
+    std::atomic<size_t> _hits{};
+    std::atomic<size_t> _misses{};
+    std::atomic<size_t> _refreshes{}; // entries read again, still the same process
+    std::atomic<size_t> _evictions{};
+  };
+} // linux
@@ -4,16 +4,76 @@
 
 #include "file_event/fanotify_reader.h"
 #include "file_event/lsprobe_reader.h"
+#include "file_event/replay_reader.h"
+#include "file_event/synthetic_reader.h"
+
+#include "container.h"
+#include "flow.h"
+#include "executor.h"
+#include "aggregate.h"
+
+#include <type_traits>
+#include <chrono>
+#include <memory>
+#include <string>
 
   struct SourceManager
   {
-    template<typename Predicate> void only(lsp::Reader&&, Predicate&&);
+    // LspReader is lsp::Reader or a source that stands in for it, e.g. lsp::ReplayReader
+    template<typename LspReader, typename Predicate> void only(LspReader&&, Predicate&&);
     template<typename Predicate> void only(fan::Reader&&, Predicate&&);
-    template<typename Predicate> void any(lsp::Reader&&, fan::Reader&&, Predicate&&);
-    template<typename Predicate> void count_stringified(lsp::Reader&&, fan::Reader&&, Predicate&&);
-    template<typename Predicate> void intersection(lsp::Reader&&, fan::Reader&&, Predicate&&);
-    template<typename Predicate> void difference(lsp::Reader&&, fan::Reader&&, Predicate&&);
-    template<typename Predicate> void buffered_difference(lsp::Reader&&, fan::Reader&&, Predicate&&, size_t buffer_size);
+    template<typename LspReader, typename Predicate> void any(LspReader&&, fan::Reader&&, Predicate&&);
+    template<typename LspReader, typename Predicate> void count_stringified(LspReader&&, fan::Reader&&, Predicate&&);
+    template<typename LspReader, typename Predicate> void intersection(LspReader&&, fan::Reader&&, Predicate&&);
+    template<typename LspReader, typename Predicate> void difference(LspReader&&, fan::Reader&&, Predicate&&);
+    template<typename LspReader, typename Predicate> void buffered_difference(LspReader&&, fan::Reader&&, Predicate&&, size_t buffer_size);
+
+    // what the joins hold on to, the lsprobe views are copied into pooled events
+    using lsp_event_t = lsp::pooled_ptr<lsp::FileEvent>;
+    using fan_event_t = fan::Reader::event_t;
+
+    // runs both sources through a stage of lsp_event_t and fan_event_t
+    // batches, lsp::window_join or lsp::set_difference, and logs what it emits
+    template<typename LspReader, typename Predicate, typename Join>
+      void join(LspReader&&, fan::Reader&&, Predicate&&, Join&&, const char * mode);
+
+    // lets the kernel drop fanotify events the predicate would reject anyway
+    template<typename Predicate> static void pushdown(fan::Reader&, const Predicate&);
+
+    template<typename LspReader>
+      void listen(
+	  LspReader&&
+	  , lsp::Sender<typename std::decay_t<LspReader>::batch_t>&&
+	  , fan::Reader&&
+	  , lsp::Sender<fan::Reader::batch_t>&&
+	  );
+
+    // joins the batches of the readers, see lsp::rebatch
+    template<typename Batch> lsp::rebatch<Batch> rebatch() const {return {_batchSize, _batchLatency};}
+
+    // bounds what a reader has queued in the pipeline, see lsp::Flow
+    template<typename Batch>
+      std::shared_ptr<lsp::BoundedFlow<Batch>> flow(std::string name, stlab::sender<Batch> send) const
+      {
+	return lsp::BoundedFlow<Batch>::make(std::move(name), _flow, std::move(send));
+      }
+
+    // where the stages of a source run: the lsmonitor executor, if there is
+    // one, or stlab::default_executor
+    enum Source : unsigned {LSPROBE, FANOTIFY, MERGED};
+    lsp::Executor::Handle executor(Source source) const
+    {
+      return (_executor ? _executor->handle(source) : lsp::Executor::Handle{});
+    }
+
+    unsigned _uringDepth{}; // reads in flight per source, 0 keeps a thread per source
+    size_t _batchSize{1};   // events per batch at most
+    std::chrono::microseconds _batchLatency{1000}; // until a batch that is not full goes on
+    lsp::Flow::Config _flow{};                      // per reader
+    lsp::Executor * _executor{};
+    std::chrono::milliseconds _joinWindow{100}; // how long an event waits for its match
+    size_t _joinCapacity{65536};                // events per source in the window at most
+    lsp::Aggregate::Config _aggregate{};        // what count_stringified counts by
   };
 
 #include "source_manager.hpp"
@@ -2,7 +2,10 @@
 #include "variant.h"
 #include "lspredicate/cmdl_expression.h"
 #include "container.h"
+#include "join.h"
+#include "aggregate.h"
 #include "broadcast.h"
+#include "file_event/uring_ingest.h"
 
 #include "stlab/concurrency/channel.hpp"
 #include "stlab/concurrency/default_executor.hpp"
@@ -16,9 +19,29 @@
 #include <iostream>
 #include <set>
 #include <iterator>
+#include <variant>
 
 namespace lsp
 {
+  // Events interned at ingestion compare their filenames as symbols, see
+  // lspredicate::interner. The order of symbols is not the one of the
+  // strings, but it is a total order, which is all the joins need.
+  template<typename L, typename R>
+    bool sameFilename(const L& l, const R& r)
+    {
+      if (l->filenameSymbol && r->filenameSymbol)
+	return (l->filenameSymbol == r->filenameSymbol);
+      return (l->filename == r->filename);
+    }
+
+  template<typename L, typename R>
+    bool filenameBefore(const L& l, const R& r)
+    {
+      if (l->filenameSymbol && r->filenameSymbol)
+	return (l->filenameSymbol < r->filenameSymbol);
+      return (l->filename < r->filename);
+    }
+
   struct FilenameEqual
   {
     template<typename L, typename R>
@@ -38,15 +61,15 @@ namespace lsp
 	return std::equal(
 	    std::begin(l), std::end(l)
 	    , std::begin(r), std::end(r)
-	    , [](const auto& l, const auto& r) {return (l->filename == r->filename);}
+	    , [](const auto& l, const auto& r) {return sameFilename(l, r);}
             );
       }
 
     template<typename L, typename R>
       bool operator()(const L& l, const R& r) const
       {
-	spdlog::debug("{0} vs {1}", l->filename, r->filename);
-	return (l->filename == r->filename);
+	LSP_DEBUG("{0} vs {1}", l->filename, r->filename);
+	return sameFilename(l, r);
       }
 
   };
@@ -56,7 +79,7 @@ namespace lsp
     template<typename L, typename R>
       bool operator()(const L& l, const R& r) const
       {
-	return (l->filename < r->filename);
+	return filenameBefore(l, r);
       }
   };
 } //lsp
@@ -71,133 +94,218 @@ void printStats(const std::map<std::string, size_t>& stats, int width = 70)
 }
 
 template<typename Predicate>
-void SourceManager::only(lsp::Reader&& reader, Predicate&& predicate)
+void SourceManager::pushdown(fan::Reader& reader, const Predicate& predicate)
+{
+  if constexpr (std::is_same_v<std::decay_t<Predicate>, lsp::predicate::CmdlExpression>)
+    reader.pushdown(predicate);
+}
+
+// Runs both readers until they stop: either on a thread each or, if io_uring
+// is enabled and supported, on the calling thread with several reads in flight.
+template<typename LspReader>
+void SourceManager::listen(
+    LspReader&& lsp_reader
+    , lsp::Sender<typename std::decay_t<LspReader>::batch_t>&& lsp_send
+    , fan::Reader&& fan_reader
+    , lsp::Sender<fan::Reader::batch_t>&& fan_send
+    )
+{
+  if constexpr (std::is_same_v<std::decay_t<LspReader>, lsp::Reader>) // only lsprobe is read with io_uring
+  {
+    if (_uringDepth && lsp::Uring::supported())
+    {
+      spdlog::info("Reading sources with io_uring, {0} fanotify reads in flight...", _uringDepth);
+
+      lsp_reader.open();
+      fan_reader._send = std::move(fan_send);
+      fan_reader.open("/home/", 0); // io_uring waits for a blocking fd itself, no poll needed
+
+      lsp::UringIngest ingest(_uringDepth);
+      ingest.add("lsprobe", lsp_reader._fd, lsp_reader._batch * LSP_EVENT_MAX_SIZE
+	  , [&lsp_reader, &lsp_send](const std::shared_ptr<lsp::Slab>& slab, size_t size)
+	    {
+	      return lsp_reader.handleRead(slab, size, lsp_send);
+	    }
+	  , true // records span reads
+	  );
+      ingest.add("fanotify", fan_reader._fad, fan_reader.bufferSize()
+	  , [&fan_reader](const std::shared_ptr<lsp::Slab>& slab, size_t size)
+	    {
+	      fan_reader.parseEvents(slab->data.data(), size);
+	      return size; // a read returns whole fanotify events
+	    }
+	  );
+      ingest.run([]{return lsp::Reader::stopping.load() || fan::Reader::stopping.load();});
+
+      lsp_reader.report();
+      return;
+    }
+  }
+
+  if (_uringDepth)
+    spdlog::warn("io_uring is not available, reading sources on separate threads");
+
+  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_send));
+  std::thread fan_thread(std::move(fan_reader), std::move(fan_send), std::string("/home/"));
+
+  fan_thread.join();
+  lsp_thread.join();
+}
+
+template<typename LspReader, typename Predicate>
+void SourceManager::only(LspReader&& reader, Predicate&& predicate)
 {
-  using event_t = std::unique_ptr<lsp::FileEvent>;
-  stlab::sender<event_t> sender;
-  stlab::receiver<event_t> receiver;
-  std::tie(sender, receiver) = stlab::channel<event_t>(stlab::default_executor);
+  using batch_t = typename std::decay_t<LspReader>::batch_t;
+  stlab::sender<batch_t> sender;
+  stlab::receiver<batch_t> receiver;
+  std::tie(sender, receiver) = stlab::channel<batch_t>(executor(LSPROBE));
+  auto flow = this->flow("lsprobe", std::move(sender));
 
   auto r = receiver
-    | [](event_t event)
+    | rebatch<batch_t>()
+    | lsp::batch_filter<batch_t, Predicate>{predicate, flow}
+    | [flow](batch_t batch)
       {
-	spdlog::debug("only | {0}", __func__, event->stringify());
-	return event;
-      }
-    | lsp::filter<event_t, Predicate>{predicate}
-    | [](auto&& event) {spdlog::info("only | {0}", event->stringify());};
+	for (const auto& event : batch) spdlog::info("only | {0}", event->stringify());
+	flow->release(batch.size());
+      };
 
   receiver.set_ready();
 
-  reader.operator()(std::move(sender)); // listen and send
+  reader.operator()(lsp::sender(flow)); // listen and send
+
+  printStats(lsp::Flow::statsAll());
 }
 
 template<typename Predicate>
 void SourceManager::only(fan::Reader&& reader, Predicate&& predicate)
 {
-  using event_t = std::unique_ptr<fan::FileEvent>;
-  stlab::sender<event_t> sender;
-  stlab::receiver<event_t> receiver;
-  std::tie(sender, receiver) = stlab::channel<event_t>(stlab::default_executor);
+  using batch_t = fan::Reader::batch_t;
+  stlab::sender<batch_t> sender;
+  stlab::receiver<batch_t> receiver;
+  std::tie(sender, receiver) = stlab::channel<batch_t>(executor(FANOTIFY));
+  auto flow = this->flow("fanotify", std::move(sender));
 
   auto r = receiver
-    | [](event_t event)
+    | rebatch<batch_t>()
+    | lsp::batch_filter<batch_t, Predicate>{predicate, flow}
+    | [flow](batch_t batch)
       {
-	spdlog::debug("only | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<event_t, Predicate>{predicate}
-    | [](auto&& event) {spdlog::info("only | {0}", event->stringify());};
+	for (const auto& event : batch) spdlog::info("only | {0}", event->stringify());
+	flow->release(batch.size());
+      };
 
   receiver.set_ready();
 
-  reader.operator()(std::move(sender), std::string("/home/")); // listen and send
+  pushdown(reader, predicate);
+  reader.operator()(lsp::sender(flow), std::string("/home/")); // listen and send
+
+  printStats(lsp::Flow::statsAll());
 }
 
-template<typename Predicate>
-void SourceManager::any(lsp::Reader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
+template<typename LspReader, typename Predicate>
+void SourceManager::any(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
 {
-  using lsp_event_t = std::unique_ptr<lsp::FileEvent>;
-  using fan_event_t = std::unique_ptr<fan::FileEvent>;
+  using lsp_batch_t = typename std::decay_t<LspReader>::batch_t;
+  using fan_batch_t = fan::Reader::batch_t;
 
-  auto lsp_channel = stlab::channel<lsp_event_t>(stlab::default_executor);
-  auto fan_channel = stlab::channel<fan_event_t>(stlab::default_executor);
+  auto lsp_channel = stlab::channel<lsp_batch_t>(executor(LSPROBE));
+  auto fan_channel = stlab::channel<fan_batch_t>(executor(FANOTIFY));
+  auto lsp_flow = flow("lsprobe", std::move(lsp_channel.first));
+  auto fan_flow = flow("fanotify", std::move(fan_channel.first));
 
   auto lsp_r =
     lsp_channel.second
-    | [](lsp_event_t event)
+    | rebatch<lsp_batch_t>()
+    | lsp::batch_filter<lsp_batch_t, Predicate>{predicate, lsp_flow}
+    | [lsp_flow](lsp_batch_t batch)
       {
-	spdlog::debug("any | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<lsp_event_t, Predicate>{predicate}
-    | [](auto&& event) {spdlog::info("any | {0}", event->stringify());};
+	for (const auto& event : batch) spdlog::info("any | {0}", event->stringify());
+	lsp_flow->release(batch.size());
+      };
 
   auto fan_r =
     fan_channel.second
-    | [](fan_event_t event)
+    | rebatch<fan_batch_t>()
+    | lsp::batch_filter<fan_batch_t, Predicate>{predicate, fan_flow}
+    | [fan_flow](fan_batch_t batch)
       {
-	spdlog::debug("any | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<fan_event_t, Predicate>{predicate}
-    | [](auto&& event) {spdlog::info("any | {0}", event->stringify());};
+	for (const auto& event : batch) spdlog::info("any | {0}", event->stringify());
+	fan_flow->release(batch.size());
+      };
 
   lsp_channel.second.set_ready();
   fan_channel.second.set_ready();
 
-  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_channel.first));
-  std::thread fan_thread(std::move(fan_reader), std::move(fan_channel.first), std::string("/home/"));
+  pushdown(fan_reader, predicate);
+  listen(std::move(lsp_reader), lsp::sender(lsp_flow), std::move(fan_reader), lsp::sender(fan_flow));
 
-  fan_thread.join();
-  lsp_thread.join();
+  printStats(lsp::Flow::statsAll());
 }
 
-template<typename Predicate>
-void SourceManager::count_stringified(lsp::Reader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
+template<typename LspReader, typename Predicate>
+void SourceManager::count_stringified(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
 {
-  using lsp_event_t = std::unique_ptr<lsp::FileEvent>;
-  stlab::sender<lsp_event_t> lsp_send;
-  stlab::receiver<lsp_event_t> lsp_receive;
+  using lsp_batch_t = typename std::decay_t<LspReader>::batch_t;
+  stlab::sender<lsp_batch_t> lsp_send;
+  stlab::receiver<lsp_batch_t> lsp_receive;
 
-  using fan_event_t = std::unique_ptr<fan::FileEvent>;
-  stlab::sender<fan_event_t> fan_send;
-  stlab::receiver<fan_event_t> fan_receive;
+  using fan_batch_t = fan::Reader::batch_t;
+  stlab::sender<fan_batch_t> fan_send;
+  stlab::receiver<fan_batch_t> fan_receive;
 
-  std::tie(lsp_send, lsp_receive) = stlab::channel<lsp_event_t>(stlab::default_executor);
-  std::tie(fan_send, fan_receive) = stlab::channel<fan_event_t>(stlab::default_executor);
+  std::tie(lsp_send, lsp_receive) = stlab::channel<lsp_batch_t>(executor(LSPROBE));
+  std::tie(fan_send, fan_receive) = stlab::channel<fan_batch_t>(executor(FANOTIFY));
 
-  std::map<std::string, size_t> stats;
+  auto lsp_flow = flow("lsprobe", std::move(lsp_send));
+  auto fan_flow = flow("fanotify", std::move(fan_send));
+
+  // the stages of both sources count into shards of their own
+  lsp::Aggregate aggregate{_aggregate};
+
+  // the lines keep the flow they came through, the broadcast releases them
+  using lines_t = std::pair<std::vector<std::string>, std::shared_ptr<lsp::Flow>>;
+  auto stringify = [](const auto& batch, std::shared_ptr<lsp::Flow> flow)
+  {
+    lines_t lines{{}, std::move(flow)};
+    lines.first.reserve(batch.size());
+    for (const auto& event : batch)
+      lines.first.push_back(event->stringify());
+    return lines;
+  };
 
   auto lsp_r =
     lsp_receive
-    | [](lsp_event_t event)
+    | rebatch<lsp_batch_t>()
+    | lsp::batch_filter<lsp_batch_t, Predicate>{predicate, lsp_flow}
+    | [stringify, lsp_flow, &aggregate](lsp_batch_t batch)
       {
-	spdlog::debug("count_stringified | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<lsp_event_t, Predicate>{predicate}
-    | [](auto&& event){return event->stringify();};
+	aggregate.add(batch);
+	return stringify(batch, lsp_flow);
+      };
 
   auto fan_r =
     fan_receive
-    | [](fan_event_t event)
+    | rebatch<fan_batch_t>()
+    | lsp::batch_filter<fan_batch_t, Predicate>{predicate, fan_flow}
+    | [stringify, fan_flow, &aggregate](fan_batch_t batch)
       {
-	spdlog::debug("count_stringified | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<fan_event_t, Predicate>{predicate}
-    | [](auto&& event){return event->stringify();};
+	aggregate.add(batch);
+	return stringify(batch, fan_flow);
+      };
 
   ctl::broadcast broadcast;
   broadcast.setup();
 
-  auto merged = stlab::merge_channel<stlab::unordered_t>(stlab::default_executor
-      , [&stats, &broadcast](std::string&& str)
+  auto merged = stlab::merge_channel<stlab::unordered_t>(executor(MERGED)
+      , [&broadcast](lines_t&& lines)
 	{
-	  spdlog::info("count_stringified | {0}", str);
-	  stats[str]++;
-	  broadcast.send(std::move(str));
+	  for (auto& str : lines.first)
+	  {
+	    spdlog::info("count_stringified | {0}", str);
+	    broadcast.send(std::move(str));
+	  }
+	  lines.second->release(lines.first.size());
 	}
       , std::move(lsp_r)
       , std::move(fan_r)
@@ -207,219 +315,113 @@ void SourceManager::count_stringified(lsp::Reader&& lsp_reader, fan::Reader&& fa
   fan_receive.set_ready();
 
   std::thread br_thread(&ctl::broadcast::listen, &broadcast);
-  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_send));
-  std::thread fan_thread(std::move(fan_reader), std::move(fan_send), std::string("/home/"));
 
-  fan_thread.join();
-  lsp_thread.join();
+  pushdown(fan_reader, predicate);
+  listen(std::move(lsp_reader), lsp::sender(lsp_flow), std::move(fan_reader), lsp::sender(fan_flow));
+
   br_thread.join();
 
-  printStats(stats, 125);
+  printStats(aggregate.stats(), 125);
+  printStats(lsp::Flow::statsAll());
 }
 
-template<typename Predicate>
-void SourceManager::intersection(lsp::Reader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
+template<typename LspReader, typename Predicate>
+void SourceManager::intersection(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
 {
-  using lsp_event_t = std::unique_ptr<lsp::FileEvent>;
-  using fan_event_t = std::unique_ptr<fan::FileEvent>;
-
-  auto lsp_channel = stlab::channel<lsp_event_t>(stlab::default_executor);
-  auto fan_channel = stlab::channel<fan_event_t>(stlab::default_executor);
-
-  auto lsp_r =
-    lsp_channel.second
-    | [](auto&& event)
-      {
-	spdlog::debug("intersection | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<lsp_event_t, Predicate>{predicate};
-
-  auto fan_r =
-    fan_channel.second
-    | [](auto event)
-      {
-	spdlog::debug("intersection | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<fan_event_t, Predicate>{predicate};
-
-  auto combined_channel =
-    stlab::zip_with(stlab::default_executor
-      , lsp::adjacent_if<lsp::FilenameEqual, lsp_event_t, fan_event_t>{lsp::FilenameEqual{}}
-      , std::move(lsp_r)
-      , std::move(fan_r)
-      )
-    | [](auto&& event_variant)
-      {
-	if (event_variant.index() == 0) // lsp_event_t
-	{
-	  auto event = std::move(std::get<0>(event_variant));
-	  spdlog::info("intersection | {0}", event->stringify());
-	}
-	else if (event_variant.index() == 1) // fan_event_t
-	{
-	  auto event = std::move(std::get<1>(event_variant));
-	  spdlog::info("intersection | {0}", event->stringify());
-	}
-	else
-	{
-	  spdlog::warn("intersection | unknown variant index: {0}", event_variant.index());
-	}
-      };
-
-  lsp_channel.second.set_ready();
-  fan_channel.second.set_ready();
-
-  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_channel.first));
-  std::thread fan_thread(std::move(fan_reader), std::move(fan_channel.first), std::string("/home/"));
+  using join_t = lsp::window_join<lsp_event_t, fan_event_t>;
+  join(std::move(lsp_reader), std::move(fan_reader), std::move(predicate)
+      , join_t{join_t::Emit::MATCHED, _joinWindow, _joinCapacity}
+      , "intersection"
+      );
+}
 
-  fan_thread.join();
-  lsp_thread.join();
+template<typename LspReader, typename Predicate>
+void SourceManager::difference(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
+{
+  using join_t = lsp::window_join<lsp_event_t, fan_event_t>;
+  join(std::move(lsp_reader), std::move(fan_reader), std::move(predicate)
+      , join_t{join_t::Emit::UNMATCHED, _joinWindow, _joinCapacity}
+      , "difference"
+      );
 }
 
-template<typename Predicate>
-void SourceManager::difference(lsp::Reader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate)
+// The events of both sources are filtered, then merged into the join stage
+// and what it emits is logged.
+template<typename LspReader, typename Predicate, typename Join>
+void SourceManager::join(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate, Join&& stage, const char * mode)
 {
-  using lsp_event_t = std::unique_ptr<lsp::FileEvent>;
-  using fan_event_t = std::unique_ptr<fan::FileEvent>;
+  using lsp_batch_t = typename std::decay_t<LspReader>::batch_t;
+  using fan_batch_t = fan::Reader::batch_t;
+  using join_t = std::decay_t<Join>;
+  using input_t = typename join_t::input_type;
 
-  auto lsp_channel = stlab::channel<lsp_event_t>(stlab::default_executor);
-  auto fan_channel = stlab::channel<fan_event_t>(stlab::default_executor);
+  auto lsp_channel = stlab::channel<lsp_batch_t>(executor(LSPROBE));
+  auto fan_channel = stlab::channel<fan_batch_t>(executor(FANOTIFY));
+  auto lsp_flow = flow("lsprobe", std::move(lsp_channel.first));
+  auto fan_flow = flow("fanotify", std::move(fan_channel.first));
 
   std::map<std::string, size_t> stats;
 
+  // the window bounds what it holds itself, the flows let go of the events entering it
   auto lsp_r =
     lsp_channel.second
-    | [](auto event)
+    | rebatch<lsp_batch_t>()
+    | lsp::batch_filter<lsp_batch_t, Predicate>{predicate, lsp_flow}
+    | [lsp_flow](lsp_batch_t batch)
       {
-	spdlog::info("difference | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<lsp_event_t, Predicate>{predicate};
+	std::vector<lsp_event_t> events;
+	events.reserve(batch.size());
+	for (const auto& view : batch)
+	  events.push_back(lsp::pooled(view));
+	lsp_flow->release(batch.size());
+	return input_t(std::in_place_index<0>, std::move(events));
+      };
 
   auto fan_r =
     fan_channel.second
-    | [](auto event)
+    | rebatch<fan_batch_t>()
+    | lsp::batch_filter<fan_batch_t, Predicate>{predicate, fan_flow}
+    | [fan_flow](fan_batch_t batch)
       {
-	spdlog::info("difference | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<fan_event_t, Predicate>{predicate};
-
-  auto combined_channel = stlab::zip_with(stlab::default_executor
-      , lsp::adjacent_if<
-	  decltype(std::not_fn(lsp::FilenameEqual{}))
-	  , lsp_event_t
-	  , fan_event_t
-	  >{std::not_fn(lsp::FilenameEqual{})}
+	fan_flow->release(batch.size());
+	return input_t(std::in_place_index<1>, std::move(batch));
+      };
+
+  auto joined = stlab::merge_channel<stlab::unordered_t>(executor(MERGED)
+      , std::forward<Join>(stage)
       , std::move(lsp_r)
       , std::move(fan_r)
       )
-    | [&stats](auto&& event_variant)
+    | [&stats, mode](typename join_t::output_type events)
       {
-	if (event_variant.index() == 0) // lsp_event_t
-	{
-	  auto event = std::move(std::get<0>(event_variant));
-	  spdlog::info("difference | {0}", event->stringify());
-	  stats[event->filename]++;
-	}
-	else if (event_variant.index() == 1) // fan_event_t
-	{
-	  auto event = std::move(std::get<1>(event_variant));
-	  spdlog::info("difference | {0}", event->stringify());
-	  stats[event->filename]++;
-	}
-	else
-	{
-	  spdlog::warn("difference | unknown variant index: {0}", event_variant.index());
-	}
+	for (const auto& event : events)
+	  std::visit([&stats, mode](const auto& e)
+	      {
+		spdlog::info("{0} | {1}", mode, e->stringify());
+		stats[e->filename]++;
+	      }
+	      , event
+	      );
       };
 
   lsp_channel.second.set_ready();
   fan_channel.second.set_ready();
 
-  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_channel.first));
-  std::thread fan_thread(std::move(fan_reader), std::move(fan_channel.first), std::string("/home/"));
-
-  fan_thread.join();
-  lsp_thread.join();
+  pushdown(fan_reader, predicate);
+  listen(std::move(lsp_reader), lsp::sender(lsp_flow), std::move(fan_reader), lsp::sender(fan_flow));
 
   printStats(stats);
-
+  printStats(lsp::Flow::statsAll());
 }
 
-template<typename Predicate>
-void SourceManager::buffered_difference(lsp::Reader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate, size_t buffer_size)
+// Reports what only one source saw, see lsp::set_difference: unlike
+// difference, the sources are compared on the filename alone, so a file both
+// saw is not reported even if the pids differ.
+template<typename LspReader, typename Predicate>
+void SourceManager::buffered_difference(LspReader&& lsp_reader, fan::Reader&& fan_reader, Predicate&& predicate, size_t buffer_size)
 {
-  using lsp_event_t = std::unique_ptr<lsp::FileEvent>;
-  using fan_event_t = std::unique_ptr<fan::FileEvent>;
-
-  auto lsp_channel = stlab::channel<lsp_event_t>(stlab::default_executor);
-  auto fan_channel = stlab::channel<fan_event_t>(stlab::default_executor);
-
-  using lsp_buffer_t = std::multiset<lsp_event_t>;
-  using fan_buffer_t = std::multiset<fan_event_t>;
-
-  std::map<std::string, size_t> stats;
-
-  auto lsp_r =
-    lsp_channel.second
-    | [](auto event)
-      {
-	spdlog::info("buffered_difference | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<lsp_event_t, Predicate>{predicate}
-    | lsp::queue<lsp_buffer_t>(buffer_size);
-
-  auto fan_r =
-    fan_channel.second
-    | [](auto event)
-      {
-	spdlog::info("buffered_difference | {0}", event->stringify());
-	return event;
-      }
-    | lsp::filter<fan_event_t, Predicate>{predicate}
-    | lsp::queue<fan_buffer_t>(buffer_size);
-
-  auto combined_channel = stlab::zip_with(stlab::default_executor
-      , lsp::adjacent_if<
-	  decltype(std::not_fn(lsp::FilenameEqual{}))
-	  , lsp_event_t
-	  , fan_event_t
-	  >{std::not_fn(lsp::FilenameEqual{})}
-      , std::move(lsp_r)
-      , std::move(fan_r)
-      )
-    | [&stats](auto&& event_variant)
-      {
-	if (event_variant.index() == 0) // lsp_event_t
-	{
-	  auto event = std::move(std::get<0>(event_variant));
-	  spdlog::info("buffered_difference | {0}", event->stringify());
-	  stats[event->filename]++;
-	}
-	else if (event_variant.index() == 1) // fan_event_t
-	{
-	  auto event = std::move(std::get<1>(event_variant));
-	  spdlog::info("buffered_difference | {0}", event->stringify());
-	  stats[event->filename]++;
-	}
-	else
-	{
-	  spdlog::warn("buffered_difference | unknown variant index: {0}", event_variant.index());
-	}
-      };
-  lsp_channel.second.set_ready();
-  fan_channel.second.set_ready();
-
-  std::thread lsp_thread(std::move(lsp_reader), std::move(lsp_channel.first));
-  std::thread fan_thread(std::move(fan_reader), std::move(fan_channel.first), std::string("/home/"));
-
-  fan_thread.join();
-  lsp_thread.join();
-
-  printStats(stats);
-
+  join(std::move(lsp_reader), std::move(fan_reader), std::move(predicate)
+      , lsp::set_difference<lsp_event_t, fan_event_t>{_joinWindow, buffer_size}
+      , "buffered_difference"
+      );
 }
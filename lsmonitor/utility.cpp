@@ -1,4 +1,5 @@
 #include "utility.h"
+#include "process_cache.h"
 #include "spdlog/spdlog.h"
 #include "fmt/format.h"
 
@@ -8,8 +9,8 @@
 #include <errno.h>
 #include <cstring>
 #include <unistd.h>
+#include <limits.h>
 #include <vector>
-#include <fstream>
 
 std::string linux::getPwuser(uid_t uid)
 {
@@ -49,30 +50,37 @@ std::string linux::getPwgroup(gid_t gid)
 
 std::string linux::getPidComm(pid_t pid)
 {
-  std::string comm("no_process");
-  std::ifstream commFile(fmt::format("/proc/{0}/comm", pid).c_str());
-  if (commFile.is_open())
-    std::getline(commFile, comm);
-  return comm;
+  return ProcessCache::instance().comm(pid);
+}
+
+pid_t linux::getPidGroup(pid_t pid)
+{
+  return ProcessCache::instance().pgid(pid);
+}
+
+pid_t linux::getPidInfo(pid_t pid, std::string& comm)
+{
+  return ProcessCache::instance().info(pid, comm);
 }
 
 std::string linux::getFdPath(int fd)
 {
-  std::string fdPath = fmt::format("/proc/self/fd/{0}", fd);
-  std::string file("error");
-  std::vector<char> path(PATH_MAX);
-  path[PATH_MAX - 1] = 0;
+  return std::string(readFdPath(fd));
+}
+
+// readlink(2) into a buffer of the calling thread, no allocation per call
+std::string_view linux::readFdPath(int fd)
+{
+  thread_local char path[PATH_MAX];
+  char fdPath[32];
+  auto end = fmt::format_to_n(fdPath, sizeof(fdPath) - 1, "/proc/self/fd/{0}", fd).out;
+  *end = 0;
 
-  ssize_t pathLen = readlink(fdPath.c_str(), path.data(), path.size() - 2);
+  ssize_t pathLen = readlink(fdPath, path, sizeof(path));
   if (pathLen > 0)
-  {
-    file.assign(path.data(), pathLen);
-  }
-  else
-  {
-    std::error_code err(errno, std::system_category());
-    spdlog::warn("Unable to get link of '{0}': {1} - {2}", fdPath, err.value(), err.message());
-  }
+    return std::string_view(path, pathLen);
 
-  return file;
+  std::error_code err(errno, std::system_category());
+  spdlog::warn("Unable to get link of '{0}': {1} - {2}", fdPath, err.value(), err.message());
+  return "error";
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <sys/types.h>
 
 namespace linux
@@ -8,5 +9,8 @@ namespace linux
   std::string getPwuser(uid_t);
   std::string getPwgroup(gid_t);
   std::string getPidComm(pid_t);
+  pid_t getPidGroup(pid_t);
+  pid_t getPidInfo(pid_t, std::string& comm); // the process group, and the comm into comm
   std::string getFdPath(int fd);
+  std::string_view readFdPath(int fd); // valid until the next call on the thread
 }
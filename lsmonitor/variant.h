@@ -1,9 +1,16 @@
 #pragma once
 
 #include "spdlog/spdlog.h"
+#include "debug.h"
 
+#include "join.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <variant>
 #include <optional>
+#include <vector>
 
 #include <stlab/concurrency/channel.hpp>
 
@@ -85,7 +92,7 @@ namespace lsp
         push_adjacent_if(std::forward<Ts>(values)...);
         if (!_results.empty())
 	{
-	  spdlog::debug("{0}: {1}", __PRETTY_FUNCTION__, _results.size());
+	  LSP_DEBUG("{0}: {1}", __PRETTY_FUNCTION__, _results.size());
           _state = stlab::yield_immediate;
 	}
 	else
@@ -100,7 +107,7 @@ namespace lsp
 	  result = std::move(_results.back());
 	  _results.pop_back();
 	  _state = (_results.empty() ? stlab::await_forever : stlab::yield_immediate);
-	  spdlog::debug("{0}", __PRETTY_FUNCTION__);
+	  LSP_DEBUG("{0}", __PRETTY_FUNCTION__);
 	}
 	return result;
       }
@@ -122,62 +129,257 @@ namespace lsp
       auto state() const {return _state;}
     };
 
-  template<typename L, typename R, typename Less>
+  // Buffered difference of two sources. Each side holds its recent events
+  // in a flat window sorted by (filename, arrival), and the windows are
+  // diffed with a linear merge: an event found on both sides is dropped with
+  // its counterpart, the oldest with the oldest, and one still alone
+  // _window after it arrived is emitted. Arrivals are sorted by themselves
+  // and merged into the window in place, so a pass stays linear.
+  //
+  // The window follows the skew between the sources: twice the arrival gap
+  // of the events of a file to the nearest one on the other side, never
+  // shorter than the window it was given nor longer than max_window.
+  // fanotify merges repeated events, so a hot file often has extra events
+  // on one side, and the oldest of them would pair with fresh events of the
+  // other side at gaps close to the window: measured on those pairs the
+  // window would ratchet up. Only gaps within the window count, the skew of
+  // a pass is the 90th percentile of its gaps, and the window grows by a
+  // quarter at most per pass. A side holds at most _capacity events, the
+  // oldest beyond that are emitted early.
+  template<typename L, typename R>
     struct set_difference
     {
-      using value_type = std::variant<typename L::value_type, typename R::value_type>;
+      using clock = std::chrono::steady_clock;
+      using value_type = std::variant<L, R>;
+      using input_type = std::variant<std::vector<L>, std::vector<R>>;
+      using output_type = std::vector<value_type>;
 
-      Less _less{};
-      std::vector<value_type> _results{};
+      static constexpr std::chrono::nanoseconds max_window = std::chrono::seconds(1);
+
+      template<typename E>
+	struct Entry
+	{
+	  uint64_t file{}; // see lsp::filename_key
+	  clock::time_point arrived{};
+	  E event{};
+
+	  bool operator<(const Entry& other) const
+	  {
+	    return (file < other.file || (file == other.file && arrived < other.arrived));
+	  }
+	};
+
+      template<typename E>
+	struct Side
+	{
+	  std::vector<Entry<E>> window{}; // sorted
+	  std::vector<Entry<E>> incoming{}; // arrival order
+	};
+
+      std::chrono::nanoseconds _floor{};
+      std::chrono::nanoseconds _window{};
+      size_t _capacity{};
+      std::chrono::nanoseconds _skew{}; // recent, decays by 1/8 a pass
+      std::vector<std::chrono::nanoseconds> _gaps{}; // sampled in a pass
+      Side<L> _left{};
+      Side<R> _right{};
+      clock::time_point _oldest{clock::time_point::max()}; // of the events held
+      clock::time_point _passed{};
+      output_type _out{};
       stlab::process_state_scheduled _state = stlab::await_forever;
 
-      void await(L&& l, R&& r)
+      set_difference(std::chrono::nanoseconds window, size_t capacity)
+	: _floor(std::max(window, std::chrono::nanoseconds(1)))
+	, _window(_floor)
+	, _capacity(std::max<size_t>(1, capacity))
+      {}
+
+      void await(input_type&& input)
       {
-        _results.reserve(l.size() + r.size());
-	auto lit = std::begin(l);
-	auto lEndIt = std::end(l);
+	auto now = clock::now();
+	if (input.index() == 0)
+	  arrive(_left, std::get<0>(input), now);
+	else
+	  arrive(_right, std::get<1>(input), now);
+	schedule(now);
+      }
+
+      template<typename E>
+	void arrive(Side<E>& side, std::vector<E>& events, clock::time_point now)
+	{
+	  side.incoming.reserve(side.incoming.size() + events.size());
+	  for (auto& event : events)
+	  {
+	    uint64_t file = filename_key(event);
+	    side.incoming.push_back(Entry<E>{file, now, std::move(event)});
+	  }
+	  if (!events.empty())
+	    _oldest = std::min(_oldest, now);
+	}
 
-	auto rit = std::begin(r);
-	auto rEndIt = std::end(r);
+      template<typename E>
+	static void sort(Side<E>& side)
+	{
+	  // arrivals are in time order, a stable sort on the file keeps it
+	  std::stable_sort(side.incoming.begin(), side.incoming.end()
+	      , [](const Entry<E>& l, const Entry<E>& r) {return l.file < r.file;}
+	      );
+	  size_t sorted = side.window.size();
+	  std::move(side.incoming.begin(), side.incoming.end(), std::back_inserter(side.window));
+	  side.incoming.clear();
+	  std::inplace_merge(side.window.begin(), side.window.begin() + sorted, side.window.end());
+	}
 
-	while (lit != lEndIt && rit != rEndIt)
+      // emits the entry at `at` if it is due, or moves it to `kept` to keep it
+      template<size_t I, typename E>
+	void settle(std::vector<Entry<E>>& window, size_t at, size_t& kept, clock::time_point due)
 	{
-	  if (_less(*lit, *rit))
+	  Entry<E>& entry = window[at];
+	  if (entry.arrived <= due)
+	    _out.emplace_back(std::in_place_index<I>, std::move(entry.event));
+	  else
 	  {
-	    _results.emplace_back(value_type(std::move(l.extract(lit).value())));
-	    lit = std::begin(l);
+	    if (kept != at)
+	      window[kept] = std::move(entry);
+	    ++kept;
 	  }
-	  else if (_less(*rit, *lit))
+	}
+
+      // The gap of each right event of a file to the nearest left one: the
+      // pairs dropped are oldest with oldest, but an extra event on one side
+      // would make their gaps those of events far apart.
+      template<typename Left, typename Right>
+	void sample(const Left& l, size_t i, size_t le, const Right& r, size_t j, size_t re)
+	{
+	  for (size_t k = i; j < re; ++j)
 	  {
-	    _results.emplace_back(value_type(std::move(r.extract(rit).value())));
-	    rit = std::begin(r);
+	    while (k + 1 < le && l[k + 1].arrived <= r[j].arrived)
+	      ++k;
+	    auto gap = std::chrono::abs(r[j].arrived - l[k].arrived);
+	    if (k + 1 < le)
+	      gap = std::min(gap, std::chrono::abs(l[k + 1].arrived - r[j].arrived));
+	    if (gap <= _window)
+	      _gaps.push_back(gap);
 	  }
+	}
+
+      void pass(clock::time_point now)
+      {
+	sort(_left);
+	sort(_right);
+
+	auto& l = _left.window;
+	auto& r = _right.window;
+	const clock::time_point due = now - _window;
+	_gaps.clear();
+	size_t i = 0;
+	size_t j = 0;
+	size_t li = 0;
+	size_t rj = 0;
+	while (i < l.size() && j < r.size())
+	{
+	  if (l[i].file < r[j].file)
+	    settle<0>(l, i++, li, due);
+	  else if (r[j].file < l[i].file)
+	    settle<1>(r, j++, rj, due);
 	  else
 	  {
-	    l.extract(lit);
-	    lit = std::begin(l);
-
-	    r.extract(rit);
-	    rit = std::begin(r);
+	    // the runs of the file, the longer one keeps its newest events
+	    size_t le = i;
+	    size_t re = j;
+	    while (le < l.size() && l[le].file == l[i].file) ++le;
+	    while (re < r.size() && r[re].file == r[j].file) ++re;
+	    sample(l, i, le, r, j, re);
+	    LSP_DEBUG("{0}: {1} on both sides", __PRETTY_FUNCTION__, l[i].event->filename);
+	    size_t pairs = std::min(le - i, re - j);
+	    i += pairs;
+	    j += pairs;
 	  }
 	}
+	while (i < l.size())
+	  settle<0>(l, i++, li, due);
+	while (j < r.size())
+	  settle<1>(r, j++, rj, due);
+	l.resize(li);
+	r.resize(rj);
 
-        if (!_results.empty())
-          _state = stlab::yield_immediate;
-	else
-	  _state = stlab::await_forever;
+	trim<0>(l);
+	trim<1>(r);
+
+	_oldest = clock::time_point::max();
+	for (const auto& entry : l)
+	  _oldest = std::min(_oldest, entry.arrived);
+	for (const auto& entry : r)
+	  _oldest = std::min(_oldest, entry.arrived);
+
+	std::chrono::nanoseconds skew{};
+	if (!_gaps.empty())
+	{
+	  auto at = _gaps.begin() + (_gaps.size() * 9 / 10);
+	  std::nth_element(_gaps.begin(), at, _gaps.end());
+	  skew = *at;
+	}
+	_skew = std::max(skew, _skew - _skew / 8);
+	auto ceiling = std::min(_window + _window / 4, max_window);
+	_window = std::clamp(2 * _skew, _floor, std::max(_floor, ceiling));
+	_passed = now;
       }
 
-      value_type yield()
+      // emits the oldest events of a window over capacity
+      template<size_t I, typename E>
+	void trim(std::vector<Entry<E>>& window)
+	{
+	  if (window.size() <= _capacity)
+	    return;
+	  std::vector<clock::time_point> arrivals;
+	  arrivals.reserve(window.size());
+	  for (const auto& entry : window)
+	    arrivals.push_back(entry.arrived);
+	  size_t excess = window.size() - _capacity;
+	  auto last = arrivals.begin() + (excess - 1);
+	  std::nth_element(arrivals.begin(), last, arrivals.end());
+	  // of the events that arrived at *last, only as many as needed go
+	  size_t ties = excess - std::count_if(arrivals.begin(), last, [&last](auto t) {return t < *last;});
+
+	  size_t kept = 0;
+	  for (size_t at = 0; at < window.size(); ++at)
+	  {
+	    bool tie = (window[at].arrived == *last && ties > 0);
+	    ties -= tie;
+	    // everything before *last is due, and the first ties at it
+	    settle<I>(window, at, kept, (tie ? *last : *last - clock::duration(1)));
+	  }
+	  window.resize(kept);
+	}
+
+      // a pass when the oldest event is due, at most every quarter window
+      void schedule(clock::time_point now)
       {
-	value_type result;
-	if (!_results.empty())
+	if (!_out.empty() || _left.window.size() + _left.incoming.size() > _capacity
+	    || _right.window.size() + _right.incoming.size() > _capacity)
+	  _state = stlab::yield_immediate;
+	else if (_oldest == clock::time_point::max())
+	  _state = stlab::await_forever;
+	else
 	{
-	  result = std::move(_results.back());
-	  _results.pop_back();
+	  auto at = std::max(_oldest + _window, _passed + _window / 4);
+	  if (at <= now)
+	    _state = stlab::yield_immediate;
+	  else // stlab calls yield() if nothing arrives until then
+	    _state = stlab::process_state_scheduled{stlab::process_state::await, at - now};
 	}
-	_state = (_results.empty() ? stlab::await_forever : stlab::yield_immediate);
-	return result;
+      }
+
+      // may be empty, when the pass found nothing to emit
+      output_type yield()
+      {
+	auto now = clock::now();
+	if (_out.empty())
+	  pass(now);
+	output_type out = std::move(_out);
+	_out.clear();
+	schedule(now);
+	return out;
       }
 
       void set_error(std::exception_ptr error)
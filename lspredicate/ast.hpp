@@ -5,6 +5,7 @@
 #include <boost/spirit/home/x3/support/ast/position_tagged.hpp>
 #include <boost/fusion/include/io.hpp>
 #include <list>
+#include <vector>
 #include <string>
 
 namespace lspredicate
@@ -13,7 +14,7 @@ namespace lspredicate
   {
     namespace x3 = boost::spirit::x3;
 
-    enum class comparison_operator {EQ, NEQ};
+    enum class comparison_operator {EQ, NEQ, GLOB, PREFIX, CONTAINS, IN};
     enum class comparison_identifier
     {
 	EVENT
@@ -70,11 +71,20 @@ namespace lspredicate
       std::list<conjunctive_operation> tail;
     };
 
+    // `in @path`: the set is read from the file, an entry per line
+    struct set_file
+    {
+      std::string path;
+    };
+
     struct comparison_value
       : x3::variant<
         bool
         , long
         , std::string
+	, std::vector<long>
+	, std::vector<std::string>
+	, set_file
         >
     {
       using base_type::base_type;
@@ -32,6 +32,11 @@ BOOST_FUSION_ADAPT_STRUCT(
     , (std::list<lspredicate::ast::conjunctive_operation>, tail)
     )
 
+BOOST_FUSION_ADAPT_STRUCT(
+    lspredicate::ast::set_file
+    , (std::string, path)
+    )
+
 BOOST_FUSION_ADAPT_STRUCT(
     lspredicate::ast::comparison_operation
     , (lspredicate::ast::comparison_operator, operator_)
@@ -0,0 +1,248 @@
+#include "automaton.hpp"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "fmt/format.h"
+
+namespace lspredicate
+{
+  namespace
+  {
+    using position = automaton::position;
+
+    std::bitset<256> any_but_slash()
+    {
+      std::bitset<256> set;
+      set.set();
+      set.reset('/');
+      return set;
+    }
+
+    std::bitset<256> one(unsigned char c)
+    {
+      std::bitset<256> set;
+      set.set(c);
+      return set;
+    }
+
+    void literal(std::vector<position>& positions, std::string_view text)
+    {
+      for (unsigned char c : text)
+	positions.push_back(position{one(c), false});
+    }
+
+    // [abc], [a-z], [!a-z] or [^a-z]; returns false if there is no closing ']'
+    bool bracket(std::string_view pattern, size_t& i, std::bitset<256>& set)
+    {
+      size_t j = i + 1;
+      bool negate = (j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^'));
+      if (negate)
+	++j;
+      size_t first = j;
+      for (; j < pattern.size() && (pattern[j] != ']' || j == first); ++j)
+      {
+	unsigned char from = pattern[j];
+	unsigned char to = from;
+	if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']')
+	{
+	  to = pattern[j + 2];
+	  j += 2;
+	}
+	for (unsigned c = from; c <= to; ++c)
+	  set.set(c);
+      }
+      if (j >= pattern.size())
+	return false;
+      if (negate)
+      {
+	set.flip();
+	set.reset('/');
+      }
+      i = j;
+      return true;
+    }
+
+    void glob(std::vector<position>& positions, std::string_view pattern)
+    {
+      for (size_t i = 0; i < pattern.size(); ++i)
+      {
+	char c = pattern[i];
+	if (c == '*' && i + 1 < pattern.size() && pattern[i + 1] == '*')
+	{
+	  positions.push_back(position{std::bitset<256>().set(), true});
+	  ++i;
+	}
+	else if (c == '*')
+	  positions.push_back(position{any_but_slash(), true});
+	else if (c == '?')
+	  positions.push_back(position{any_but_slash(), false});
+	else if (c == '\\' && i + 1 < pattern.size())
+	  positions.push_back(position{one(pattern[++i]), false});
+	else
+	{
+	  std::bitset<256> set;
+	  if (c == '[' && bracket(pattern, i, set))
+	    positions.push_back(position{set, false});
+	  else
+	    positions.push_back(position{one(c), false});
+	}
+      }
+    }
+
+    // an NFA state is a pattern and a position in it, encoded as base + index
+    struct nfa
+    {
+      const std::vector<std::vector<position>>& _patterns;
+      std::vector<uint32_t> _base{};
+
+      explicit nfa(const std::vector<std::vector<position>>& patterns)
+	: _patterns(patterns)
+      {
+	uint32_t base = 0;
+	for (const auto& p : _patterns)
+	{
+	  _base.push_back(base);
+	  base += static_cast<uint32_t>(p.size() + 1);
+	}
+	_base.push_back(base);
+      }
+
+      std::pair<uint32_t, uint32_t> decode(uint32_t state) const
+      {
+	uint32_t pattern = static_cast<uint32_t>(
+	    std::upper_bound(_base.begin(), _base.end(), state) - _base.begin() - 1);
+	return {pattern, state - _base[pattern]};
+      }
+
+      // a star may match nothing, so its successor is reachable as well
+      void close(std::vector<uint32_t>& states) const
+      {
+	for (size_t i = 0; i < states.size(); ++i)
+	{
+	  auto [pattern, index] = decode(states[i]);
+	  const auto& positions = _patterns[pattern];
+	  if (index < positions.size() && positions[index].star)
+	    states.push_back(states[i] + 1);
+	}
+	std::sort(states.begin(), states.end());
+	states.erase(std::unique(states.begin(), states.end()), states.end());
+      }
+
+      std::vector<uint32_t> step(const std::vector<uint32_t>& states, unsigned char c) const
+      {
+	std::vector<uint32_t> next;
+	for (uint32_t state : states)
+	{
+	  auto [pattern, index] = decode(state);
+	  const auto& positions = _patterns[pattern];
+	  if (index < positions.size() && positions[index].set.test(c))
+	    next.push_back(positions[index].star ? state : state + 1);
+	}
+	close(next);
+	return next;
+      }
+    };
+  }
+
+  uint32_t automaton::add(kind k, std::string_view pattern)
+  {
+    std::vector<position> positions;
+    switch (k)
+    {
+      case kind::GLOB:
+	glob(positions, pattern);
+	break;
+      case kind::PREFIX:
+	literal(positions, pattern);
+	positions.push_back(position{std::bitset<256>().set(), true});
+	break;
+      case kind::CONTAINS:
+	positions.push_back(position{std::bitset<256>().set(), true});
+	literal(positions, pattern);
+	positions.push_back(position{std::bitset<256>().set(), true});
+	break;
+    }
+    _patterns.push_back(std::move(positions));
+    return static_cast<uint32_t>(_patterns.size() - 1);
+  }
+
+  void automaton::build()
+  {
+    // bytes no pattern tells apart share a column of the table
+    std::map<std::vector<bool>, uint8_t> signatures;
+    std::vector<unsigned char> representative;
+    for (unsigned c = 0; c < 256; ++c)
+    {
+      std::vector<bool> signature;
+      for (const auto& positions : _patterns)
+	for (const auto& p : positions)
+	  signature.push_back(p.set.test(c));
+      auto it = signatures.find(signature);
+      if (it == signatures.end())
+      {
+	it = signatures.emplace(std::move(signature), static_cast<uint8_t>(signatures.size())).first;
+	representative.push_back(static_cast<unsigned char>(c));
+      }
+      _classes[c] = it->second;
+    }
+    _classCount = static_cast<uint32_t>(representative.size());
+
+    // subset construction, the empty set is the dead state
+    nfa n(_patterns);
+    std::map<std::vector<uint32_t>, uint32_t> ids;
+    std::vector<std::vector<uint32_t>> states;
+    auto intern = [&ids, &states](std::vector<uint32_t>&& set)
+    {
+      auto it = ids.find(set);
+      if (it != ids.end())
+	return it->second;
+      if (states.size() >= maxStates)
+	throw std::runtime_error(fmt::format("Patterns are too complex: more than {0} automaton states", maxStates));
+      uint32_t id = static_cast<uint32_t>(states.size());
+      ids.emplace(set, id);
+      states.push_back(std::move(set));
+      return id;
+    };
+
+    intern({});
+    std::vector<uint32_t> start;
+    for (size_t p = 0; p < _patterns.size(); ++p)
+      start.push_back(n._base[p]);
+    n.close(start);
+    _start = intern(std::move(start));
+
+    _table.clear();
+    for (uint32_t s = 0; s < states.size(); ++s)
+    {
+      _table.resize((s + 1) * _classCount);
+      for (uint32_t cls = 0; cls < _classCount; ++cls)
+      {
+	uint32_t next = (s == dead ? dead : intern(n.step(states[s], representative[cls])));
+	_table[s * _classCount + cls] = next;
+      }
+    }
+
+    _acceptsAt.clear();
+    _accepts.clear();
+    for (const auto& set : states)
+    {
+      _acceptsAt.push_back(static_cast<uint32_t>(_accepts.size()));
+      for (uint32_t state : set)
+      {
+	auto [pattern, index] = n.decode(state);
+	if (index == _patterns[pattern].size())
+	  _accepts.push_back(pattern);
+      }
+    }
+    _acceptsAt.push_back(static_cast<uint32_t>(_accepts.size()));
+  }
+
+  bool automaton::accepts(uint32_t state, uint32_t pattern) const
+  {
+    auto first = _accepts.begin() + _acceptsAt[state];
+    auto last = _accepts.begin() + _acceptsAt[state + 1];
+    return std::binary_search(first, last, pattern);
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <bitset>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace lspredicate
+{
+  // All the patterns compared with one field, compiled into a single DFA.
+  // A path is scanned once whatever the number of patterns; the state it
+  // ends in tells which of them matched.
+  struct automaton
+  {
+    enum class kind : uint8_t
+    {
+      GLOB       // whole string: '*' within a component, '**' across, '?', [a-z], [!a-z]
+      , PREFIX   // string starts with the pattern
+      , CONTAINS // string has the pattern anywhere
+    };
+
+    static constexpr uint32_t dead = 0;
+    static constexpr size_t maxStates = 1 << 16;
+
+    // returns the pattern id tested with accepts()
+    uint32_t add(kind k, std::string_view pattern);
+    void build();
+
+    bool empty() const {return _patterns.empty();}
+
+    uint32_t run(std::string_view text) const
+    {
+      uint32_t state = _start;
+      const uint32_t * table = _table.data();
+      for (unsigned char c : text)
+      {
+	state = table[state * _classCount + _classes[c]];
+	if (state == dead)
+	  break;
+      }
+      return state;
+    }
+
+    bool accepts(uint32_t state, uint32_t pattern) const;
+
+    // pattern compiled into positions, a star position loops on its set
+    struct position
+    {
+      std::bitset<256> set{};
+      bool star{};
+    };
+    std::vector<std::vector<position>> _patterns{};
+
+    uint8_t _classes[256]{};           // byte -> equivalence class
+    uint32_t _classCount{1};
+    uint32_t _start{dead};
+    std::vector<uint32_t> _table{};    // state * _classCount + class -> state
+    std::vector<uint32_t> _acceptsAt{}; // state -> offset in _accepts, one extra at the end
+    std::vector<uint32_t> _accepts{};  // sorted pattern ids per state
+  };
+}
@@ -8,10 +8,12 @@
 
 lsp::predicate::CmdlExpression::CmdlExpression(const lspredicate::ast::expression& expr)
   : _expr(expr)
+  , _program(_expr)
 {}
 
 lsp::predicate::CmdlExpression::CmdlExpression(lspredicate::ast::expression&& expr)
   : _expr(std::move(expr))
+  , _program(_expr)
 {}
 
 lsp::predicate::CmdlExpression::CmdlExpression(const std::string& expr)
@@ -35,9 +37,8 @@ lsp::predicate::CmdlExpression::CmdlExpression(const std::string& expr)
     if (r && it == end)
     {
       _empty = false;
-      std::ostringstream out;
-      lspredicate::ast::print(out, _expr);
-      spdlog::debug("Predicate: {0}", out.str());
+      _program = lspredicate::program(_expr);
+      print();
     }
     else
     {
@@ -49,3 +50,21 @@ lsp::predicate::CmdlExpression::CmdlExpression(const std::string& expr)
 }
 
 // ----------------------------------------------------------------------------
+
+void lsp::predicate::CmdlExpression::print() const
+{
+  if (!spdlog::should_log(spdlog::level::debug))
+    return;
+
+  std::ostringstream out;
+  lspredicate::ast::print(out, _expr);
+  spdlog::debug("Predicate: {0}", out.str());
+  out.str("");
+  _program.print_plan(out);
+  spdlog::debug("Predicate plan:\n{0}", out.str());
+  out.str("");
+  _program.print(out);
+  spdlog::debug("Compiled predicate:\n{0}", out.str());
+}
+
+// ----------------------------------------------------------------------------
@@ -1,17 +1,90 @@
 #pragma once
 
 #include "lspredicate/ast.hpp"
+#include "lspredicate/program.hpp"
+#include "lspredicate/event_traits.hpp"
+#include "fmt/format.h"
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
 
 namespace lsp
 {
   namespace predicate
   {
+    // the fields of an event as the compiled program asks for them
+    template<typename T>
+      struct event_fields
+      {
+	using traits = event_traits<T>;
+
+	const T& _event;
+
+	long number(lspredicate::ast::comparison_identifier identifier) const
+	{
+	  switch(identifier)
+	  {
+	    case lspredicate::ast::comparison_identifier::EVENT      : return traits::code(_event);
+	    case lspredicate::ast::comparison_identifier::PROCESS_PID: return traits::pid(_event);
+	    case lspredicate::ast::comparison_identifier::PROCESS_UID: return traits::uid(_event);
+	    case lspredicate::ast::comparison_identifier::PROCESS_GID: return traits::gid(_event);
+	    default:
+	      throw std::runtime_error(fmt::format("Not a number identifier index: {0}", static_cast<long>(identifier)));
+	  }
+	}
+
+	std::string_view text(lspredicate::ast::comparison_identifier identifier) const
+	{
+	  return (identifier == lspredicate::ast::comparison_identifier::FILE_PATH
+	      ? traits::filename(_event)
+	      : traits::process(_event));
+	}
+
+	lspredicate::symbol_t symbol(lspredicate::ast::comparison_identifier identifier) const
+	{
+	  return (identifier == lspredicate::ast::comparison_identifier::FILE_PATH
+	      ? traits::filename_symbol(_event)
+	      : traits::process_symbol(_event));
+	}
+      };
+
     template<typename T>
-      bool evaluate(const T& value, const lspredicate::ast::expression&);
+      bool evaluate(const T& value, const lspredicate::program& program)
+      {
+	return program.run(event_fields<T>{value});
+      }
+
+    // the events of a batch as the lanes of program::select()
+    template<typename Batch>
+      struct batch_lanes
+      {
+	using event_t = typename Batch::value_type;
+
+	const Batch& _batch;
+
+	size_t size() const {return _batch.size();}
+
+	long number(size_t lane, lspredicate::ast::comparison_identifier identifier) const
+	{
+	  return event_fields<event_t>{_batch[lane]}.number(identifier);
+	}
+
+	std::string_view text(size_t lane, lspredicate::ast::comparison_identifier identifier) const
+	{
+	  return event_fields<event_t>{_batch[lane]}.text(identifier);
+	}
+
+	lspredicate::symbol_t symbol(size_t lane, lspredicate::ast::comparison_identifier identifier) const
+	{
+	  return event_fields<event_t>{_batch[lane]}.symbol(identifier);
+	}
+      };
 
     struct CmdlExpression
     {
       lspredicate::ast::expression  _expr{};
+      lspredicate::program          _program{};
       bool _empty{true};
 
       CmdlExpression(const std::string& str);
@@ -24,7 +97,20 @@ namespace lsp
       template<typename T>
 	bool operator()(const T& value) const
 	{
-	  return (_empty || evaluate(value, _expr));
+	  return (_empty || evaluate(value, _program));
+	}
+
+      // sets the bit of every event of the batch that passes, see lspredicate/lanes.hpp
+      template<typename Batch>
+	void select(const Batch& batch, uint64_t * bits) const
+	{
+	  if (_empty)
+	  {
+	    for (size_t w = 0; w < lspredicate::lane_words(batch.size()); ++w)
+	      bits[w] = (batch.size() - w * 64 < 64 ? (uint64_t(1) << (batch.size() % 64)) - 1 : ~uint64_t(0));
+	    return;
+	  }
+	  _program.select(batch_lanes<Batch>{batch}, bits);
 	}
     };
 
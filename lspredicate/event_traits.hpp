@@ -0,0 +1,23 @@
+#pragma once
+
+namespace lsp
+{
+  namespace predicate
+  {
+    // How the predicate reads the fields of an event type. A specialization
+    // provides static inline accessors, so the generic evaluator compiles
+    // each comparison down to a member load:
+    //
+    //   static long code(const Event&);
+    //   static std::string_view filename(const Event&);
+    //   static std::string_view process(const Event&);
+    //   static long pid(const Event&);
+    //   static long uid(const Event&);
+    //   static long gid(const Event&);
+    //   static uint64_t filename_symbol(const Event&); // see interner, none if not interned
+    //   static uint64_t process_symbol(const Event&);
+    template<typename Event>
+      struct event_traits;
+
+  } // predicate
+} // lsp
@@ -22,6 +22,10 @@ namespace lspredicate
       add
 	("==", ast::comparison_operator::EQ)
 	("!=", ast::comparison_operator::NEQ)
+	("=~", ast::comparison_operator::GLOB)
+	("^=", ast::comparison_operator::PREFIX)
+	("contains", ast::comparison_operator::CONTAINS)
+	("in", ast::comparison_operator::IN)
 	;
     }
   } comparison_operator;
@@ -63,6 +67,7 @@ namespace lspredicate
     struct comparison_expr_class;
     struct comparison_operation_class;
     struct comparison_value_class;
+    struct set_file_class;
 
     using disjunctive_expr_type      = x3::rule<disjunctive_expr_class     , ast::disjunctive_expression>;
     using conjunctive_expr_type      = x3::rule<conjunctive_expr_class     , ast::conjunctive_expression>;
@@ -71,6 +76,7 @@ namespace lspredicate
     using comparison_expr_type       = x3::rule<comparison_expr_class      , ast::comparison>;
     using comparison_operation_type  = x3::rule<comparison_operation_class , ast::comparison_operation>;
     using comparison_value_type      = x3::rule<comparison_value_class     , ast::comparison_value>;
+    using set_file_type              = x3::rule<set_file_class             , ast::set_file>;
 
     disjunctive_expr_type      const disjunctive_expr      = "disjunctive_expr";
     conjunctive_expr_type      const conjunctive_expr      = "conjunctive_expr";
@@ -79,6 +85,7 @@ namespace lspredicate
     comparison_expr_type       const comparison_expr       = "comparison_expr";
     comparison_operation_type  const comparison_operation  = "comparison_operation";
     comparison_value_type      const comparison_value      = "comparison_value";
+    set_file_type              const set_file              = "set_file";
 
     expression_type            const expression            = "expression";
 
@@ -109,10 +116,18 @@ namespace lspredicate
       x3::lexeme['"' >> +(x3::char_ - '"') >> '"']
       | x3::lexeme['\'' >> +(x3::char_ - '\'') >> '\''];
 
+    auto const set_file_def =
+      x3::lexeme['@' >> +(x3::char_ - x3::space - ')')];
+
+    // sets are kept as plain vectors, a list of thousands of entries
+    // would be slow to build as a chain of comparisons
     auto const comparison_value_def =
       x3::bool_
       | x3::long_
-      | quoted_string;
+      | quoted_string
+      | ('[' >> (x3::long_ % ',') >> ']')
+      | ('[' >> (quoted_string % ',') >> ']')
+      | set_file;
 
     auto const expression_def = disjunctive_expr;
 
@@ -125,6 +140,7 @@ namespace lspredicate
 	, comparison_expr
 	, comparison_operation
 	, comparison_value
+	, set_file
 	)
 
     struct unary_expr_class : annotate_position {};
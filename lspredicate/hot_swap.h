@@ -0,0 +1,94 @@
+#pragma once
+
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+namespace lsp
+{
+  namespace predicate
+  {
+    // A predicate that can be replaced while the pipeline runs, RCU style:
+    // publish() swaps in a compiled predicate, and each filter stage sees
+    // the new generation on its next event and takes a copy. Events are
+    // never blocked. A stage pays one atomic load per event and one copy
+    // per swap. The old predicate is freed by the last stage that holds it.
+    // Copies of a HotSwap share the published slot.
+    template<typename Predicate>
+      struct HotSwap
+      {
+	struct Slot
+	{
+	  std::shared_ptr<const Predicate> _current{}; // std::atomic_load/std::atomic_store only
+	  std::atomic<uint64_t> _generation{};
+	  std::atomic<int64_t> _published{}; // steady clock, ns
+	};
+
+	explicit HotSwap(Predicate&& predicate)
+	  : _slot(std::make_shared<Slot>())
+	  , _local(predicate)
+	{
+	  std::atomic_store(&_slot->_current, std::make_shared<const Predicate>(std::move(predicate)));
+	}
+
+	// returns the generation the filter stages will switch to
+	uint64_t publish(Predicate&& predicate) const
+	{
+	  std::atomic_store(&_slot->_current, std::make_shared<const Predicate>(std::move(predicate)));
+	  _slot->_published.store(now(), std::memory_order_relaxed);
+	  return _slot->_generation.fetch_add(1, std::memory_order_release) + 1;
+	}
+
+	uint64_t generation() const
+	{
+	  return _slot->_generation.load(std::memory_order_acquire);
+	}
+
+	// the stages copy the predicate, since an adaptive one changes as it runs
+	template<typename T>
+	  bool operator()(const T& value)
+	  {
+	    uint64_t generation = _slot->_generation.load(std::memory_order_acquire);
+	    if (generation != _generation)
+	      adopt(generation);
+	    return _local(value);
+	  }
+
+	template<typename Batch, typename P = Predicate>
+	  auto select(const Batch& batch, uint64_t * bits)
+	  -> decltype(std::declval<const P&>().select(batch, bits))
+	  {
+	    uint64_t generation = _slot->_generation.load(std::memory_order_acquire);
+	    if (generation != _generation)
+	      adopt(generation);
+	    return _local.select(batch, bits);
+	  }
+
+	void adopt(uint64_t generation)
+	{
+	  _local = *std::atomic_load(&_slot->_current);
+	  _generation = generation;
+	  spdlog::info("Predicate #{0} in effect after {1} us"
+	      , generation
+	      , (now() - _slot->_published.load(std::memory_order_relaxed)) / 1000
+	      );
+	}
+
+	static int64_t now()
+	{
+	  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	      std::chrono::steady_clock::now().time_since_epoch()
+	      ).count();
+	}
+
+	std::shared_ptr<Slot> _slot;
+	Predicate _local;
+	uint64_t _generation{};
+      };
+
+  } // predicate
+} // lsp
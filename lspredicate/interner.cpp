@@ -0,0 +1,147 @@
+#include "interner.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+namespace lspredicate
+{
+  interner::interner(size_t capacity)
+    : _capacity(std::clamp<size_t>(capacity / shards, 1, max_slots))
+  {}
+
+  interner& interner::instance()
+  {
+    static interner instance;
+    return instance;
+  }
+
+  symbol_t interner::intern(std::string_view text)
+  {
+    return intern(text, false);
+  }
+
+  symbol_t interner::pin(std::string_view text)
+  {
+    return intern(text, true);
+  }
+
+  void interner::unpin(symbol_t symbol)
+  {
+    size_t index = symbol & (shards - 1);
+    uint32_t position = (symbol >> shard_bits) & (max_slots - 1);
+    uint64_t generation = symbol >> (shard_bits + slot_bits);
+
+    shard& s = _shards[index];
+    std::lock_guard<std::mutex> lock(s._mutex);
+    if (position < s._slots.size()
+	&& s._slots[position]._used
+	&& s._slots[position]._generation == generation
+	&& s._slots[position]._pins)
+      --s._slots[position]._pins;
+  }
+
+  interner::pin_set::~pin_set()
+  {
+    for (symbol_t symbol : _symbols)
+      interner::instance().unpin(symbol);
+  }
+
+  symbol_t interner::intern(std::string_view text, bool pinned)
+  {
+    size_t index = hash(text) & (shards - 1);
+    shard& s = _shards[index];
+    std::lock_guard<std::mutex> lock(s._mutex);
+
+    auto it = s._index.find(text);
+    if (it != s._index.end())
+    {
+      slot& found = s._slots[it->second];
+      found._referenced = true;
+      found._pins += pinned;
+      ++_hits;
+      return symbol(index, it->second, found._generation);
+    }
+
+    ++_misses;
+    uint32_t free = 0;
+    if (s._slots.size() < _capacity)
+    {
+      free = static_cast<uint32_t>(s._slots.size());
+      s._slots.emplace_back();
+    }
+    else
+    {
+      free = evict(s);
+      if (free == max_slots)
+	return none;
+    }
+
+    slot& added = s._slots[free];
+    added._text.assign(text.data(), text.size());
+    // 0 is never a generation, so no symbol is none
+    added._generation = (added._generation % ((uint64_t(1) << generation_bits) - 1)) + 1;
+    added._used = true;
+    added._referenced = false;
+    added._pins = pinned;
+    s._index.emplace(added._text, free);
+    return symbol(index, free, added._generation);
+  }
+
+  // the CLOCK hand clears the referenced bits on its way, so it stops
+  // within two turns unless every slot is pinned
+  uint32_t interner::evict(shard& s)
+  {
+    for (size_t step = 0; step < 2 * s._slots.size(); ++step)
+    {
+      uint32_t candidate = static_cast<uint32_t>(s._hand);
+      s._hand = (s._hand + 1) % s._slots.size();
+
+      slot& victim = s._slots[candidate];
+      if (victim._pins)
+	continue;
+      if (victim._referenced)
+      {
+	victim._referenced = false;
+	continue;
+      }
+      s._index.erase(victim._text);
+      victim._used = false;
+      ++_evictions;
+      return candidate;
+    }
+    return max_slots;
+  }
+
+  std::string interner::lookup(symbol_t symbol) const
+  {
+    size_t index = symbol & (shards - 1);
+    uint32_t position = (symbol >> shard_bits) & (max_slots - 1);
+    uint64_t generation = symbol >> (shard_bits + slot_bits);
+
+    const shard& s = _shards[index];
+    std::lock_guard<std::mutex> lock(s._mutex);
+    if (position < s._slots.size()
+	&& s._slots[position]._used
+	&& s._slots[position]._generation == generation)
+      return s._slots[position]._text;
+    return std::string();
+  }
+
+  void interner::report() const
+  {
+    size_t size = 0;
+    for (const auto& s : _shards)
+    {
+      std::lock_guard<std::mutex> lock(s._mutex);
+      size += s._index.size();
+    }
+    spdlog::info("interner: {0} strings of {1}, {2} hits, {3} misses, {4} evictions"
+	, size
+	, _capacity * shards
+	, _hits.load()
+	, _misses.load()
+	, _evictions.load()
+	);
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace lspredicate
+{
+  using symbol_t = uint64_t;
+
+  // Maps file paths and process names to 64 bit symbols, so equal strings
+  // compare as integers. The table is split in shards, each with its own
+  // lock, and holds a bounded number of strings: when a shard is full the
+  // CLOCK hand evicts a string that was not looked up since its last pass.
+  // A slot reused by another string gets a new generation, hence a new
+  // symbol, so equal symbols always mean equal strings. Equal strings have
+  // different symbols only if the string was evicted in between. The
+  // generation has 41 bits, so a slot would have to be reused 2^41 times
+  // for a symbol to come back, and the top bit of a symbol stays clear for
+  // the callers to tag hashes with. Pinned strings, e.g. the operands of a
+  // predicate, are not evicted until every pin of them is undone.
+  struct interner
+  {
+    static constexpr symbol_t none = 0;
+
+    static constexpr unsigned shard_bits      = 6;
+    static constexpr unsigned slot_bits       = 16;
+    static constexpr unsigned generation_bits = 63 - shard_bits - slot_bits;
+    static constexpr size_t   shards          = size_t(1) << shard_bits;
+    static constexpr size_t   max_slots       = size_t(1) << slot_bits; // per shard
+
+    explicit interner(size_t capacity = 1 << 20);
+
+    interner(const interner&) = delete;
+    interner& operator=(const interner&) = delete;
+
+    static interner& instance();
+
+    // none if every slot of the shard is pinned
+    symbol_t intern(std::string_view text);
+    symbol_t pin(std::string_view text);
+    void unpin(symbol_t symbol); // undoes one pin()
+
+    // the string of a symbol still interned, empty otherwise
+    std::string lookup(symbol_t symbol) const;
+
+    // unpins its symbols when the last of its owners goes, e.g. the copies
+    // of a compiled predicate
+    struct pin_set
+    {
+      pin_set() = default;
+      pin_set(const pin_set&) = delete;
+      pin_set& operator=(const pin_set&) = delete;
+      ~pin_set();
+
+      std::vector<symbol_t> _symbols{};
+    };
+
+    void report() const;
+
+    struct slot
+    {
+      std::string _text{};
+      uint64_t _generation{};
+      uint32_t _pins{};
+      bool _used{};
+      bool _referenced{};
+    };
+
+    struct shard
+    {
+      mutable std::mutex _mutex{};
+      std::unordered_map<std::string_view, uint32_t> _index{}; // keys point into the slots
+      std::deque<slot> _slots{}; // a deque, the keys of the index stay valid as it grows
+      size_t _hand{};
+    };
+
+    symbol_t intern(std::string_view text, bool pinned);
+    uint32_t evict(shard& s); // returns the slot freed
+
+    static size_t hash(std::string_view text) {return std::hash<std::string_view>{}(text);}
+
+    static symbol_t symbol(size_t shard, uint32_t slot, uint64_t generation)
+    {
+      return ((generation << (shard_bits + slot_bits)) | (symbol_t(slot) << shard_bits) | shard);
+    }
+
+    size_t _capacity{}; // per shard
+    shard _shards[shards]{};
+
+    std::atomic<size_t> _hits{};
+    std::atomic<size_t> _misses{};
+    std::atomic<size_t> _evictions{};
+  };
+}
@@ -0,0 +1,113 @@
+#include "lanes.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace lspredicate
+{
+  namespace
+  {
+    using kernel_t = void (*)(const long *, size_t, long, uint64_t *);
+
+    void equal_scalar(const long * column, size_t size, long value, uint64_t * bits)
+    {
+      for (size_t word = 0; word < lane_words(size); ++word)
+      {
+	uint64_t mask = 0;
+	size_t end = (size - word * 64 < 64 ? size - word * 64 : 64);
+	const long * lanes = column + word * 64;
+	for (size_t lane = 0; lane < end; ++lane)
+	  mask |= static_cast<uint64_t>(lanes[lane] == value) << lane;
+	bits[word] = mask;
+      }
+    }
+
+#if defined(__x86_64__)
+    static_assert(sizeof(long) == sizeof(int64_t), "lanes are compared as 64 bit integers");
+
+    __attribute__((target("avx2")))
+    void equal_avx2(const long * column, size_t size, long value, uint64_t * bits)
+    {
+      const __m256i needle = _mm256_set1_epi64x(value);
+      for (size_t word = 0; word < lane_words(size); ++word)
+      {
+	uint64_t mask = 0;
+	size_t end = (size - word * 64 < 64 ? size - word * 64 : 64);
+	const long * lanes = column + word * 64;
+	size_t lane = 0;
+	for (; lane + 4 <= end; lane += 4)
+	{
+	  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes + lane));
+	  int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, needle)));
+	  mask |= static_cast<uint64_t>(m) << lane;
+	}
+	for (; lane < end; ++lane)
+	  mask |= static_cast<uint64_t>(lanes[lane] == value) << lane;
+	bits[word] = mask;
+      }
+    }
+
+    __attribute__((target("sse4.1")))
+    void equal_sse41(const long * column, size_t size, long value, uint64_t * bits)
+    {
+      const __m128i needle = _mm_set1_epi64x(value);
+      for (size_t word = 0; word < lane_words(size); ++word)
+      {
+	uint64_t mask = 0;
+	size_t end = (size - word * 64 < 64 ? size - word * 64 : 64);
+	const long * lanes = column + word * 64;
+	size_t lane = 0;
+	for (; lane + 2 <= end; lane += 2)
+	{
+	  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + lane));
+	  int m = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, needle)));
+	  mask |= static_cast<uint64_t>(m) << lane;
+	}
+	for (; lane < end; ++lane)
+	  mask |= static_cast<uint64_t>(lanes[lane] == value) << lane;
+	bits[word] = mask;
+      }
+    }
+#endif
+
+    struct dispatch
+    {
+      kernel_t _kernel{equal_scalar};
+      const char * _name{"scalar"};
+
+      dispatch()
+      {
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+	  _kernel = equal_avx2;
+	  _name = "avx2";
+	}
+	else if (__builtin_cpu_supports("sse4.1"))
+	{
+	  _kernel = equal_sse41;
+	  _name = "sse4.1";
+	}
+#endif
+      }
+    };
+
+    const dispatch& kernels()
+    {
+      static const dispatch instance;
+      return instance;
+    }
+  }
+
+  void equal_lanes(const long * column, size_t size, long value, uint64_t * bits)
+  {
+    kernels()._kernel(column, size, value, bits);
+  }
+
+  const char * lanes_kernel()
+  {
+    return kernels()._name;
+  }
+}
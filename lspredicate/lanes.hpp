@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lspredicate
+{
+  // A batch is evaluated as lanes: bit i % 64 of word i / 64 stands for
+  // the event i. Bits past the size of the batch are always clear.
+  inline size_t lane_words(size_t size) {return (size + 63) / 64;}
+
+  // Sets the bits of the lanes where column[lane] == value and clears the
+  // others. Compares whole registers with AVX2 or SSE4.1 when the CPU has
+  // them, one lane at a time otherwise.
+  void equal_lanes(const long * column, size_t size, long value, uint64_t * bits);
+
+  // the kernel equal_lanes() picked for this CPU: "avx2", "sse4.1" or "scalar"
+  const char * lanes_kernel();
+}
@@ -0,0 +1,83 @@
+#include "path_trie.hpp"
+
+#include <algorithm>
+
+namespace lspredicate
+{
+  namespace
+  {
+    auto first_less = [](const std::pair<std::string, std::unique_ptr<path_trie::node>>& child, std::string_view component)
+    {
+      return std::string_view(child.first) < component;
+    };
+  }
+
+  std::vector<std::string_view> path_trie::split(std::string_view path)
+  {
+    std::vector<std::string_view> components;
+    size_t start = 0;
+    std::string_view component;
+    while (next(path, start, component))
+      components.push_back(component);
+    return components;
+  }
+
+  const path_trie::node * path_trie::lookup(const node& n, std::string_view component)
+  {
+    auto it = std::lower_bound(n.children.begin(), n.children.end(), component, first_less);
+    if (it == n.children.end() || it->first != component)
+      return nullptr;
+    return it->second.get();
+  }
+
+  path_trie::node& path_trie::insert(std::string_view path)
+  {
+    auto components = split(path);
+    node * n = &_root;
+    size_t i = 0;
+    while (i < components.size())
+    {
+      auto it = std::lower_bound(n->children.begin(), n->children.end(), components[i], first_less);
+      if (it == n->children.end() || it->first != components[i])
+      {
+	// nothing shares this component yet: the rest of the path is one label
+	auto child = std::make_unique<node>();
+	child->label.assign(components.begin() + i, components.end());
+	node * added = child.get();
+	n->children.emplace(it, std::string(components[i]), std::move(child));
+	return *added;
+      }
+
+      node * child = it->second.get();
+      size_t common = 0;
+      while (common < child->label.size() && i + common < components.size()
+	  && child->label[common] == components[i + common])
+	++common;
+
+      if (common < child->label.size())
+      {
+	// the path ends or branches inside the label: split the child
+	auto head = std::make_unique<node>();
+	head->label.assign(child->label.begin(), child->label.begin() + common);
+	child->label.erase(child->label.begin(), child->label.begin() + common);
+	std::string key = child->label.front();
+	head->children.emplace_back(std::move(key), std::move(it->second));
+	it->second = std::move(head);
+	child = it->second.get();
+      }
+      n = child;
+      i += common;
+    }
+    return *n;
+  }
+
+  void path_trie::add_exact(std::string_view path, uint32_t value)
+  {
+    insert(path).exact.push_back(value);
+  }
+
+  void path_trie::add_subtree(std::string_view path, uint32_t value)
+  {
+    insert(path).subtree.push_back(value);
+  }
+}
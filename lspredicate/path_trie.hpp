@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+namespace lspredicate
+{
+  // Radix tree over path components: a node holds a run of components that
+  // no other key branches off, so a deep but sparse tree stays shallow.
+  // Values are attached either to a path itself or to everything under it.
+  struct path_trie
+  {
+    struct node
+    {
+      std::vector<std::string> label{}; // components leading to this node from its parent
+      std::vector<std::pair<std::string, std::unique_ptr<node>>> children{}; // sorted by the first component
+      std::vector<uint32_t> exact{};
+      std::vector<uint32_t> subtree{};
+    };
+
+    static std::vector<std::string_view> split(std::string_view path);
+
+    void add_exact(std::string_view path, uint32_t value);
+    void add_subtree(std::string_view path, uint32_t value);
+
+    // calls f(value) for the subtree values of every node strictly above
+    // the path and for the exact values of the path itself
+    template<typename F>
+      void find(std::string_view path, F&& f) const
+      {
+	const node * n = &_root;
+	size_t start = 0;
+	std::string_view component;
+	while (next(path, start, component))
+	{
+	  for (uint32_t value : n->subtree)
+	    f(value);
+	  const node * child = lookup(*n, component);
+	  if (!child)
+	    return;
+	  // the rest of the label has to follow in the path
+	  for (size_t i = 1; i < child->label.size(); ++i)
+	    if (!next(path, start, component) || component != child->label[i])
+	      return;
+	  n = child;
+	}
+	for (uint32_t value : n->exact)
+	  f(value);
+      }
+
+    // empty components are skipped, so '//' and a trailing '/' do not count
+    static bool next(std::string_view path, size_t& start, std::string_view& component)
+    {
+      while (start < path.size() && path[start] == '/')
+	++start;
+      if (start >= path.size())
+	return false;
+      size_t end = path.find('/', start);
+      if (end == std::string_view::npos)
+	end = path.size();
+      component = path.substr(start, end - start);
+      start = end;
+      return true;
+    }
+
+    static const node * lookup(const node& n, std::string_view component);
+    node& insert(std::string_view path);
+
+    node _root{};
+  };
+}
@@ -38,6 +38,24 @@ namespace lspredicate
 	  out << ast;
 	}
 
+	template<typename T>
+	void operator()(std::vector<T> const& ast) const
+	{
+	  out << '[';
+	  for (size_t i = 0; i < ast.size(); ++i)
+	  {
+	    if (i)
+	      out << ", ";
+	    (*this)(ast[i]);
+	  }
+	  out << ']';
+	}
+
+	void operator()(ast::set_file const& ast) const
+	{
+	  out << '@' << ast.path;
+	}
+
 	void operator()(ast::disjunctive_operation const& ast) const
 	{
 	  out << " || ";
@@ -65,14 +83,17 @@ namespace lspredicate
 	       throw std::runtime_error(fmt::format("Unknown identifier index: {0}", static_cast<int>(ast.identifier)));
 	  }
 
-	  if (ast.operation_.operator_ == ast::comparison_operator::NEQ)
-	    out << " != ";
-	  else if (ast.operation_.operator_ == ast::comparison_operator::EQ)
-	    out << " == ";
-	  else
+	  switch(ast.operation_.operator_)
 	  {
-	    BOOST_ASSERT(0);
-	    return;
+	    case ast::comparison_operator::EQ      : out << " == "      ; break;
+	    case ast::comparison_operator::NEQ     : out << " != "      ; break;
+	    case ast::comparison_operator::GLOB    : out << " =~ "      ; break;
+	    case ast::comparison_operator::PREFIX  : out << " ^= "      ; break;
+	    case ast::comparison_operator::CONTAINS: out << " contains "; break;
+	    case ast::comparison_operator::IN      : out << " in "      ; break;
+	    default:
+	      BOOST_ASSERT(0);
+	      return;
 	  }
 	  boost::apply_visitor(*this, ast.operation_.operand_);
 	  out << ')';
@@ -0,0 +1,513 @@
+#include "program.hpp"
+
+#include <boost/variant/apply_visitor.hpp>
+#include <ostream>
+#include <stdexcept>
+#include <optional>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+namespace lspredicate
+{
+  namespace
+  {
+    bool is_numeric(ast::comparison_identifier identifier)
+    {
+      switch (identifier)
+      {
+	case ast::comparison_identifier::FILE_PATH:
+	case ast::comparison_identifier::PROCESS_PATH:
+	  return false;
+	default:
+	  return true;
+      }
+    }
+
+    const char * name(ast::comparison_identifier identifier)
+    {
+      switch(identifier)
+      {
+	case ast::comparison_identifier::EVENT       : return "event";
+	case ast::comparison_identifier::FILE_PATH   : return "file";
+	case ast::comparison_identifier::PROCESS_PATH: return "process";
+	case ast::comparison_identifier::PROCESS_PID : return "pid";
+	case ast::comparison_identifier::PROCESS_UID : return "uid";
+	case ast::comparison_identifier::PROCESS_GID : return "gid";
+      }
+      return "unknown";
+    }
+
+    std::optional<automaton::kind> pattern_kind(ast::comparison_operator op)
+    {
+      switch (op)
+      {
+	case ast::comparison_operator::GLOB    : return automaton::kind::GLOB;
+	case ast::comparison_operator::PREFIX  : return automaton::kind::PREFIX;
+	case ast::comparison_operator::CONTAINS: return automaton::kind::CONTAINS;
+	default                                : return std::nullopt;
+      }
+    }
+
+    // static estimate of a leaf, in rough units of an integer compare
+    double leaf_cost(const program::instruction& i)
+    {
+      switch (i.op)
+      {
+	case program::opcode::CONST:
+	  return 0.1;
+	case program::opcode::TEST:
+	  return (i.type == program::operand_type::NUMBER ? 1.0 : 2.0 + i.length / 16.0);
+	case program::opcode::MATCH:
+	  return 8.0; // the scan of the field, shared by the patterns on it
+	case program::opcode::MEMBER:
+	  return (i.type == program::operand_type::NUMBER ? 2.0 : 6.0);
+	default:
+	  return 1.0;
+      }
+    }
+
+    struct compiler
+    {
+      typedef uint32_t result_type;
+
+      program& _program;
+
+      uint32_t node(program::plan_node n) const
+      {
+	_program._plan.push_back(std::move(n));
+	return static_cast<uint32_t>(_program._plan.size() - 1);
+      }
+
+      uint32_t emit(program::instruction i) const
+      {
+	program::plan_node n;
+	n.type = program::plan_node::kind::LEAF;
+	n.cost = leaf_cost(i);
+	n.leaf = i;
+	return node(std::move(n));
+      }
+
+      uint32_t operator()(bool ast) const
+      {
+	program::instruction i;
+	i.op = program::opcode::CONST;
+	i.number = ast;
+	return emit(i);
+      }
+
+      uint32_t operator()(ast::comparison const& ast) const
+      {
+	program::instruction i;
+	i.op = program::opcode::TEST;
+	i.identifier = ast.identifier;
+	i.negate = (ast.operation_.operator_ == ast::comparison_operator::NEQ);
+
+	auto kind = pattern_kind(ast.operation_.operator_);
+	if (kind)
+	{
+	  auto string = boost::get<std::string>(&ast.operation_.operand_);
+	  int a = program::automaton_index(ast.identifier);
+	  if (a < 0 || !string)
+	    throw std::runtime_error(fmt::format("'{0}' can only be matched with a string pattern", name(ast.identifier)));
+	  i.op = program::opcode::MATCH;
+	  i.type = program::operand_type::STRING;
+	  i.id = _program._automata[a].add(*kind, *string);
+	  i.offset = static_cast<uint32_t>(_program._strings.size());
+	  i.length = static_cast<uint32_t>(string->size());
+	  _program._strings += *string;
+	  return emit(i);
+	}
+
+	if (ast.operation_.operator_ == ast::comparison_operator::IN)
+	{
+	  i.op = program::opcode::MEMBER;
+	  member(ast, i);
+	  return emit(i);
+	}
+
+	// operand types are checked here once rather than on every event
+	if (is_numeric(ast.identifier))
+	{
+	  auto number = boost::get<long>(&ast.operation_.operand_);
+	  if (!number)
+	    throw std::runtime_error(fmt::format("'{0}' has to be compared with a number", name(ast.identifier)));
+	  i.type = program::operand_type::NUMBER;
+	  i.number = *number;
+	}
+	else
+	{
+	  auto string = boost::get<std::string>(&ast.operation_.operand_);
+	  if (!string)
+	    throw std::runtime_error(fmt::format("'{0}' has to be compared with a string", name(ast.identifier)));
+	  i.type = program::operand_type::STRING;
+	  i.offset = static_cast<uint32_t>(_program._strings.size());
+	  i.length = static_cast<uint32_t>(string->size());
+	  i.symbol = interner::instance().pin(*string);
+	  if (i.symbol != interner::none)
+	    _program._pins->_symbols.push_back(i.symbol);
+	  _program._strings += *string;
+	}
+	return emit(i);
+      }
+
+      void member(ast::comparison const& ast, program::instruction& i) const
+      {
+	const auto& operand = ast.operation_.operand_;
+	std::vector<std::string> lines;
+	if (auto file = boost::get<ast::set_file>(&operand))
+	  lines = read_set(file->path);
+
+	if (is_numeric(ast.identifier))
+	{
+	  std::vector<long> values;
+	  if (auto numbers = boost::get<std::vector<long>>(&operand))
+	    values = *numbers;
+	  else if (auto number = boost::get<long>(&operand))
+	    values.push_back(*number);
+	  else if (boost::get<ast::set_file>(&operand))
+	  {
+	    for (const auto& line : lines)
+	    {
+	      size_t end = 0;
+	      long value = 0;
+	      try
+	      {
+		value = std::stol(line, &end);
+	      }
+	      catch (const std::exception&)
+	      {
+		end = 0;
+	      }
+	      if (end != line.size())
+		throw std::runtime_error(fmt::format("'{0}' is not a number in the set of '{1}'", line, name(ast.identifier)));
+	      values.push_back(value);
+	    }
+	  }
+	  else
+	    throw std::runtime_error(fmt::format("'{0}' has to be in a set of numbers", name(ast.identifier)));
+
+	  i.type = program::operand_type::NUMBER;
+	  i.id = static_cast<uint32_t>(_program._numberSets.size());
+	  _program._numberSets.emplace_back();
+	  _program._numberSets.back().build(std::move(values));
+	}
+	else
+	{
+	  if (auto strings = boost::get<std::vector<std::string>>(&operand))
+	    lines = *strings;
+	  else if (auto string = boost::get<std::string>(&operand))
+	    lines.push_back(*string);
+	  else if (!boost::get<ast::set_file>(&operand))
+	    throw std::runtime_error(fmt::format("'{0}' has to be in a set of strings", name(ast.identifier)));
+
+	  i.type = program::operand_type::STRING;
+	  i.id = static_cast<uint32_t>(_program._stringSets.size());
+	  _program._stringSets.emplace_back();
+	  _program._stringSets.back().build(lines);
+	}
+      }
+
+      // an entry per line, blank lines and lines starting with '#' are skipped
+      static std::vector<std::string> read_set(const std::string& path)
+      {
+	std::ifstream in(path);
+	if (!in.is_open())
+	  throw std::runtime_error(fmt::format("Unable to read the set from '{0}'", path));
+
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(in, line))
+	{
+	  size_t first = line.find_first_not_of(" \t\r");
+	  if (first == std::string::npos || line[first] == '#')
+	    continue;
+	  size_t last = line.find_last_not_of(" \t\r");
+	  lines.push_back(line.substr(first, last - first + 1));
+	}
+	return lines;
+      }
+
+      uint32_t operator()(ast::negated const& ast) const
+      {
+	uint32_t operand = boost::apply_visitor(*this, ast.operand_);
+	if (ast.sign != '!')
+	  return operand;
+
+	// a negated comparison just flips its operator
+	auto& n = _program._plan[operand];
+	if (n.type == program::plan_node::kind::LEAF && n.leaf.op != program::opcode::CONST)
+	{
+	  n.leaf.negate = !n.leaf.negate;
+	  return operand;
+	}
+	program::plan_node negation;
+	negation.type = program::plan_node::kind::NOT;
+	negation.children.push_back(operand);
+	return node(std::move(negation));
+      }
+
+      template<typename Expression>
+	uint32_t sequence(Expression const& ast, program::plan_node::kind type) const
+	{
+	  uint32_t head = boost::apply_visitor(*this, ast.head);
+	  if (ast.tail.empty())
+	    return head;
+
+	  std::vector<uint32_t> children{head};
+	  for (const auto& operation : ast.tail)
+	  {
+	    uint32_t child = boost::apply_visitor(*this, operation.operand_);
+	    // (a && (b && c)) is one node with three operands, to be ordered together
+	    const auto& n = _program._plan[child];
+	    if (n.type == type)
+	      children.insert(children.end(), n.children.begin(), n.children.end());
+	    else
+	      children.push_back(child);
+	  }
+	  if (_program._plan[head].type == type)
+	  {
+	    std::vector<uint32_t> flat = _program._plan[head].children;
+	    flat.insert(flat.end(), children.begin() + 1, children.end());
+	    children.swap(flat);
+	  }
+
+	  program::plan_node n;
+	  n.type = type;
+	  n.children = std::move(children);
+	  return node(std::move(n));
+	}
+
+      uint32_t operator()(ast::disjunctive_expression const& ast) const
+      {
+	return sequence(ast, program::plan_node::kind::OR);
+      }
+
+      uint32_t operator()(ast::conjunctive_expression const& ast) const
+      {
+	return sequence(ast, program::plan_node::kind::AND);
+      }
+    };
+
+    struct emitter
+    {
+      std::vector<program::plan_node>& _plan;
+      std::vector<program::instruction>& _code;
+
+      uint32_t here() const
+      {
+	return static_cast<uint32_t>(_code.size());
+      }
+
+      void operator()(uint32_t n)
+      {
+	const auto& node = _plan[n];
+	switch (node.type)
+	{
+	  case program::plan_node::kind::LEAF:
+	    _code.push_back(node.leaf);
+	    break;
+	  case program::plan_node::kind::NOT:
+	    {
+	      (*this)(node.children.front());
+	      program::instruction i;
+	      i.op = program::opcode::NOT;
+	      _code.push_back(i);
+	    }
+	    break;
+	  case program::plan_node::kind::AND:
+	  case program::plan_node::kind::OR:
+	    {
+	      std::vector<uint32_t> jumps;
+	      for (size_t c = 0; c < node.children.size(); ++c)
+	      {
+		if (c)
+		{
+		  program::instruction i;
+		  i.op = (node.type == program::plan_node::kind::AND
+		      ? program::opcode::JUMP_IF_FALSE
+		      : program::opcode::JUMP_IF_TRUE);
+		  jumps.push_back(here());
+		  _code.push_back(i);
+		}
+		(*this)(node.children[c]);
+	      }
+	      for (uint32_t j : jumps)
+		_code[j].target = here();
+	    }
+	    break;
+	}
+      }
+    };
+
+    // A jump landing on a jump of the same kind takes the second one right
+    // away, a jump landing on the opposite kind falls through it, so nested
+    // || and && leave in one step.
+    void thread_jumps(std::vector<program::instruction>& code)
+    {
+      auto is_jump = [](program::opcode op)
+      {
+	return op == program::opcode::JUMP_IF_TRUE || op == program::opcode::JUMP_IF_FALSE;
+      };
+
+      for (auto& i : code)
+      {
+	if (!is_jump(i.op))
+	  continue;
+	while (i.target < code.size() && is_jump(code[i.target].op))
+	{
+	  const auto& next = code[i.target];
+	  i.target = (next.op == i.op ? next.target : i.target + 1);
+	}
+      }
+    }
+  }
+
+  program::program(ast::expression const& ast, bool adaptive)
+    : _adaptive(adaptive)
+    , _pins(std::make_shared<interner::pin_set>())
+  {
+    _root = compiler{*this}(ast);
+    auto depth = [this](auto& self, uint32_t n) -> uint32_t
+    {
+      uint32_t deepest = 0;
+      for (uint32_t child : _plan[n].children)
+	deepest = std::max(deepest, self(self, child) + 1);
+      return deepest;
+    };
+    _depth = depth(depth, _root);
+    for (auto& a : _automata)
+      if (!a.empty())
+	a.build();
+    reorder();
+  }
+
+  void program::emit() const
+  {
+    _code.clear();
+    emitter{_plan, _code}(_root);
+    thread_jumps(_code);
+  }
+
+  // Operands of && go in the increasing order of cost / P(false), those of
+  // || of cost / P(true): the cheap ones that decide the result most often
+  // run first. The result is the same in any order, terms have no effects.
+  void program::reorder() const
+  {
+    std::vector<uint32_t> before;
+    for (const auto& node : _plan)
+      before.insert(before.end(), node.children.begin(), node.children.end());
+
+    // children always come before their parents in the plan
+    for (auto& node : _plan)
+    {
+      if (node.type == plan_node::kind::NOT)
+	node.cost = _plan[node.children.front()].cost;
+      if (node.type != plan_node::kind::AND && node.type != plan_node::kind::OR)
+	continue;
+
+      bool conjunction = (node.type == plan_node::kind::AND);
+      auto rank = [this, conjunction](uint32_t n)
+      {
+	double p = _plan[n].probability();
+	return _plan[n].cost / (conjunction ? 1.0 - p : p);
+      };
+      std::stable_sort(node.children.begin(), node.children.end()
+	  , [&rank](uint32_t l, uint32_t r){return rank(l) < rank(r);});
+
+      // each operand runs only if all the previous ones did not decide
+      double cost = 0;
+      double reached = 1.0;
+      for (uint32_t child : node.children)
+      {
+	cost += reached * _plan[child].cost;
+	double p = _plan[child].probability();
+	reached *= (conjunction ? p : 1.0 - p);
+      }
+      node.cost = cost;
+    }
+
+    std::vector<uint32_t> after;
+    for (const auto& node : _plan)
+      after.insert(after.end(), node.children.begin(), node.children.end());
+
+    if (_code.empty() || before != after)
+    {
+      emit();
+      if (!_code.empty() && _samples && spdlog::should_log(spdlog::level::debug))
+      {
+	std::ostringstream out;
+	print_plan(out);
+	spdlog::debug("Predicate reordered after {0} samples:\n{1}", _samples, out.str());
+      }
+    }
+  }
+
+  void program::print(std::ostream& out) const
+  {
+    for (size_t pc = 0; pc < _code.size(); ++pc)
+    {
+      out << fmt::format("{0:4}: ", pc);
+      print(out, _code[pc]);
+      out << '\n';
+    }
+  }
+
+  void program::print_plan(std::ostream& out) const
+  {
+    auto walk = [this, &out](auto& self, uint32_t n, int depth) -> void
+    {
+      const auto& node = _plan[n];
+      out << std::string(2 * depth, ' ');
+      switch (node.type)
+      {
+	case plan_node::kind::LEAF: print(out, node.leaf); break;
+	case plan_node::kind::AND : out << "and"; break;
+	case plan_node::kind::OR  : out << "or" ; break;
+	case plan_node::kind::NOT : out << "not"; break;
+      }
+      out << fmt::format("  [cost {0:.2f}, true {1}/{2}]\n", node.cost, node.hits, node.evaluations);
+      for (uint32_t child : node.children)
+	self(self, child, depth + 1);
+    };
+    if (!_plan.empty())
+      walk(walk, _root, 0);
+  }
+
+  void program::print(std::ostream& out, const instruction& i) const
+  {
+    switch (i.op)
+    {
+      case opcode::CONST:
+	out << "const " << (i.number ? "true" : "false");
+	break;
+      case opcode::TEST:
+	out << "test " << name(i.identifier) << (i.negate ? " != " : " == ");
+	if (i.type == operand_type::NUMBER)
+	  out << i.number;
+	else
+	  out << '\'' << string(i) << '\'';
+	break;
+      case opcode::MATCH:
+	out << "match " << name(i.identifier) << (i.negate ? " !~ '" : " ~ '") << string(i) << '\''
+	  << " #" << i.id;
+	break;
+      case opcode::MEMBER:
+	out << "member " << name(i.identifier) << (i.negate ? " not in #" : " in #") << i.id << " of "
+	  << (i.type == operand_type::NUMBER ? _numberSets[i.id].size() : _stringSets[i.id].size());
+	break;
+      case opcode::NOT:
+	out << "not";
+	break;
+      case opcode::JUMP_IF_TRUE:
+	out << "jt " << i.target;
+	break;
+      case opcode::JUMP_IF_FALSE:
+	out << "jf " << i.target;
+	break;
+    }
+  }
+}
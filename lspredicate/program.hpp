@@ -0,0 +1,434 @@
+#pragma once
+
+#include "ast.hpp"
+#include "automaton.hpp"
+#include "value_set.hpp"
+#include "lanes.hpp"
+#include "interner.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+
+namespace lspredicate
+{
+  // The expression compiled once into straight-line code over a single
+  // boolean register: comparisons set it, && and || short-circuit with
+  // forward jumps. Operands are extracted at compile time, so running it
+  // touches neither the variants nor the lists of the ast.
+  struct program
+  {
+    enum class opcode : uint8_t
+    {
+      CONST          // r = number
+      , TEST         // r = (identifier op operand)
+      , MATCH        // r = the field matches the pattern, see automaton
+      , MEMBER       // r = the field is in the set
+      , NOT          // r = !r
+      , JUMP_IF_TRUE
+      , JUMP_IF_FALSE
+    };
+
+    enum class operand_type : uint8_t
+    {
+      NUMBER
+      , STRING
+    };
+
+    struct instruction
+    {
+      opcode op{};
+      bool negate{}; // TEST: the comparison is !=
+      ast::comparison_identifier identifier{};
+      operand_type type{};
+      uint32_t target{}; // JUMP_*: index of the next instruction to run
+      uint32_t offset{}; // STRING: the operand in the string pool
+      uint32_t length{};
+      uint32_t id{};     // MATCH: pattern in the automaton of the field, MEMBER: the set
+      symbol_t symbol{}; // TEST of a path: the operand pinned in the interner
+      long number{};     // CONST, NUMBER
+    };
+
+    program() = default;
+    explicit program(ast::expression const& ast, bool adaptive = true);
+
+    bool empty() const {return _code.empty();}
+
+    std::string_view string(const instruction& i) const
+    {
+      return std::string_view(_strings.data() + i.offset, i.length);
+    }
+
+    // string fields have an automaton each for their patterns
+    static int automaton_index(ast::comparison_identifier identifier)
+    {
+      switch (identifier)
+      {
+	case ast::comparison_identifier::FILE_PATH   : return 0;
+	case ast::comparison_identifier::PROCESS_PATH: return 1;
+	default                                      : return -1;
+      }
+    }
+
+    // The expression as a tree over the leaf instructions, the code is
+    // emitted from it. Operands of && and || are kept in the order they
+    // run and are reordered from sampled statistics, see reorder().
+    struct plan_node
+    {
+      enum class kind : uint8_t
+      {
+	LEAF
+	, AND
+	, OR
+	, NOT
+      };
+
+      kind type{};
+      instruction leaf{};               // LEAF: CONST, TEST, MATCH or MEMBER
+      std::vector<uint32_t> children{}; // AND, OR: in the order they run; NOT: the operand
+      double cost{};                    // expected, in rough units of an integer compare
+      uint64_t evaluations{};           // sampled
+      uint64_t hits{};                  // sampled, evaluated to true
+
+      // Laplace estimate, so a term never sampled counts as a coin toss
+      double probability() const {return (hits + 1.0) / (evaluations + 2.0);}
+    };
+
+    static constexpr uint64_t sample_mask = 63;      // every 64th run is sampled
+    static constexpr uint64_t reorder_period = 256;  // samples between reorders
+
+    template<typename Fields>
+      bool test(const instruction& i, const Fields& fields, uint32_t (&scanned)[2]) const
+      {
+	constexpr uint32_t unscanned = ~uint32_t(0);
+	switch (i.op)
+	{
+	  case opcode::CONST:
+	    return (i.number != 0);
+	  case opcode::TEST:
+	    if (i.type == operand_type::NUMBER)
+	      return ((fields.number(i.identifier) == i.number) != i.negate);
+	    if (i.symbol)
+	    {
+	      // interned at ingestion: the symbols are equal if and only if the strings are
+	      symbol_t symbol = fields.symbol(i.identifier);
+	      if (symbol != interner::none)
+		return ((symbol == i.symbol) != i.negate);
+	    }
+	    return ((fields.text(i.identifier) == string(i)) != i.negate);
+	  case opcode::MATCH:
+	    {
+	      int a = automaton_index(i.identifier);
+	      if (scanned[a] == unscanned)
+		scanned[a] = _automata[a].run(fields.text(i.identifier));
+	      return (_automata[a].accepts(scanned[a], i.id) != i.negate);
+	    }
+	  case opcode::MEMBER:
+	    return ((i.type == operand_type::NUMBER
+		  ? _numberSets[i.id].contains(fields.number(i.identifier))
+		  : _stringSets[i.id].contains(fields.text(i.identifier))
+		  ) != i.negate);
+	  default:
+	    return false;
+	}
+      }
+
+    // Fields reads the event:
+    //   long number(ast::comparison_identifier) const;
+    //   std::string_view text(ast::comparison_identifier) const;
+    //   symbol_t symbol(ast::comparison_identifier) const; // of text(), see interner
+    // A string field is scanned by its automaton at most once per run.
+    template<typename Fields>
+      bool run(const Fields& fields) const
+      {
+	uint32_t scanned[2] = {~uint32_t(0), ~uint32_t(0)};
+	if (_adaptive && ((++_runs & sample_mask) == 0))
+	{
+	  bool r = sample(fields, _root, scanned);
+	  if (++_samples % reorder_period == 0)
+	    reorder();
+	  return r;
+	}
+
+	bool r = true;
+	const instruction * code = _code.data();
+	const uint32_t size = static_cast<uint32_t>(_code.size());
+	for (uint32_t pc = 0; pc < size; ++pc)
+	{
+	  const instruction& i = code[pc];
+	  switch (i.op)
+	  {
+	    case opcode::NOT:
+	      r = !r;
+	      break;
+	    case opcode::JUMP_IF_TRUE:
+	      if (r)
+		pc = i.target - 1;
+	      break;
+	    case opcode::JUMP_IF_FALSE:
+	      if (!r)
+		pc = i.target - 1;
+	      break;
+	    default:
+	      r = test(i, fields, scanned);
+	      break;
+	  }
+	}
+	return r;
+      }
+
+    // Evaluates every operand, without short-circuit, so each term gets an
+    // unbiased hit rate. The result is the same as run() would give.
+    template<typename Fields>
+      bool sample(const Fields& fields, uint32_t n, uint32_t (&scanned)[2]) const
+      {
+	plan_node& node = _plan[n];
+	bool r = false;
+	switch (node.type)
+	{
+	  case plan_node::kind::LEAF:
+	    r = test(node.leaf, fields, scanned);
+	    break;
+	  case plan_node::kind::NOT:
+	    r = !sample(fields, node.children.front(), scanned);
+	    break;
+	  case plan_node::kind::AND:
+	    r = true;
+	    for (uint32_t child : node.children)
+	      r = sample(fields, child, scanned) && r;
+	    break;
+	  case plan_node::kind::OR:
+	    for (uint32_t child : node.children)
+	      r = sample(fields, child, scanned) || r;
+	    break;
+	}
+	++node.evaluations;
+	node.hits += r;
+	return r;
+      }
+
+    static constexpr size_t min_lanes = 8; // smaller batches are run event by event
+
+    // a lane of a batch seen as the Fields of run()
+    template<typename Lanes>
+      struct lane_fields
+      {
+	const Lanes& _lanes;
+	size_t _lane;
+
+	long number(ast::comparison_identifier identifier) const {return _lanes.number(_lane, identifier);}
+	std::string_view text(ast::comparison_identifier identifier) const {return _lanes.text(_lane, identifier);}
+	symbol_t symbol(ast::comparison_identifier identifier) const {return _lanes.symbol(_lane, identifier);}
+      };
+
+    // the numeric fields of a batch read into columns, kept between batches
+    struct batch_columns
+    {
+      std::vector<long> _numbers[4]{};
+      bool _loaded[4]{};
+      std::vector<uint32_t> _scanned[2]{}; // automaton state per lane, see test()
+      std::vector<uint64_t> _masks{};
+    };
+
+    static int column_index(ast::comparison_identifier identifier)
+    {
+      switch (identifier)
+      {
+	case ast::comparison_identifier::EVENT      : return 0;
+	case ast::comparison_identifier::PROCESS_PID: return 1;
+	case ast::comparison_identifier::PROCESS_UID: return 2;
+	case ast::comparison_identifier::PROCESS_GID: return 3;
+	default                                     : return -1;
+      }
+    }
+
+    // Evaluates a whole batch, Lanes reads it:
+    //   size_t size() const;
+    //   long number(size_t lane, ast::comparison_identifier) const;
+    //   std::string_view text(size_t lane, ast::comparison_identifier) const;
+    //   symbol_t symbol(size_t lane, ast::comparison_identifier) const;
+    // and sets lane_words(size) words of bits, see lanes.hpp. Numeric
+    // comparisons run over whole columns, the others only for the lanes
+    // whose result is still open. The result is the one of run() per lane.
+    template<typename Lanes>
+      void select(const Lanes& lanes, uint64_t * bits) const
+      {
+	const size_t size = lanes.size();
+	const size_t words = lane_words(size);
+	if (size < min_lanes)
+	{
+	  std::fill(bits, bits + words, 0);
+	  for (size_t lane = 0; lane < size; ++lane)
+	    bits[lane / 64] |= static_cast<uint64_t>(run(lane_fields<Lanes>{lanes, lane})) << (lane % 64);
+	  return;
+	}
+
+	for (auto& loaded : _columns._loaded)
+	  loaded = false;
+	for (int a = 0; a < 2; ++a)
+	  if (!_automata[a].empty())
+	    _columns._scanned[a].assign(size, ~uint32_t(0));
+
+	// every level of the plan needs two masks, the top one the whole batch
+	_columns._masks.assign(words * (2 * _depth + 3), 0);
+	uint64_t * all = _columns._masks.data();
+	std::fill(all, all + words, ~uint64_t(0));
+	if (size % 64)
+	  all[words - 1] = (uint64_t(1) << (size % 64)) - 1;
+
+	// a batch is sampled every 64 batches, for every lane
+	bool sampling = (_adaptive && ((++_runs & sample_mask) == 0));
+	select(lanes, _root, all, bits, all + words, sampling);
+	if (sampling)
+	  sampled(size);
+      }
+
+    // the lanes of `in` where the node is true go to `out`
+    template<typename Lanes>
+      void select(const Lanes& lanes, uint32_t n, const uint64_t * in, uint64_t * out, uint64_t * scratch, bool sampling) const
+      {
+	const size_t size = lanes.size();
+	const size_t words = lane_words(size);
+	plan_node& node = _plan[n];
+	switch (node.type)
+	{
+	  case plan_node::kind::LEAF:
+	    select_leaf(lanes, node.leaf, in, out);
+	    break;
+	  case plan_node::kind::NOT:
+	    select(lanes, node.children.front(), in, out, scratch, sampling);
+	    for (size_t w = 0; w < words; ++w)
+	      out[w] = in[w] & ~out[w];
+	    break;
+	  case plan_node::kind::AND:
+	  case plan_node::kind::OR:
+	    {
+	      // AND narrows the lanes still true, OR the lanes still false
+	      bool conjunction = (node.type == plan_node::kind::AND);
+	      uint64_t * open = scratch;
+	      uint64_t * result = scratch + words;
+	      std::copy(in, in + words, open);
+	      std::fill(out, out + words, (conjunction ? ~uint64_t(0) : 0));
+	      for (uint32_t child : node.children)
+	      {
+		select(lanes, child, (sampling ? in : open), result, scratch + 2 * words, sampling);
+		uint64_t any = 0;
+		for (size_t w = 0; w < words; ++w)
+		{
+		  if (conjunction)
+		  {
+		    out[w] &= result[w];
+		    open[w] &= result[w];
+		  }
+		  else
+		  {
+		    out[w] |= result[w];
+		    open[w] &= ~result[w];
+		  }
+		  any |= open[w];
+		}
+		if (!any && !sampling)
+		  break;
+	      }
+	      for (size_t w = 0; w < words; ++w)
+		out[w] &= in[w];
+	    }
+	    break;
+	}
+
+	if (sampling)
+	  for (size_t w = 0; w < words; ++w)
+	  {
+	    node.evaluations += __builtin_popcountll(in[w]);
+	    node.hits += __builtin_popcountll(out[w]);
+	  }
+      }
+
+    template<typename Lanes>
+      void select_leaf(const Lanes& lanes, const instruction& i, const uint64_t * in, uint64_t * out) const
+      {
+	const size_t size = lanes.size();
+	const size_t words = lane_words(size);
+	if (i.op == opcode::CONST)
+	{
+	  for (size_t w = 0; w < words; ++w)
+	    out[w] = (i.number ? in[w] : 0);
+	  return;
+	}
+
+	if (i.op == opcode::TEST && i.type == operand_type::NUMBER)
+	{
+	  int c = column_index(i.identifier);
+	  auto& column = _columns._numbers[c];
+	  if (!_columns._loaded[c])
+	  {
+	    column.resize(size);
+	    for (size_t lane = 0; lane < size; ++lane)
+	      column[lane] = lanes.number(lane, i.identifier);
+	    _columns._loaded[c] = true;
+	  }
+	  equal_lanes(column.data(), size, i.number, out);
+	  for (size_t w = 0; w < words; ++w)
+	    out[w] = (i.negate ? ~out[w] : out[w]) & in[w];
+	  return;
+	}
+
+	// strings and sets, one lane at a time
+	for (size_t w = 0; w < words; ++w)
+	{
+	  uint64_t mask = 0;
+	  for (uint64_t open = in[w]; open; open &= open - 1)
+	  {
+	    size_t lane = w * 64 + __builtin_ctzll(open);
+	    uint32_t scanned[2] = {~uint32_t(0), ~uint32_t(0)};
+	    int a = automaton_index(i.identifier);
+	    if (i.op == opcode::MATCH)
+	      scanned[a] = _columns._scanned[a][lane];
+	    if (test(i, lane_fields<Lanes>{lanes, lane}, scanned))
+	      mask |= (open & -open);
+	    if (i.op == opcode::MATCH)
+	      _columns._scanned[a][lane] = scanned[a];
+	  }
+	  out[w] = mask;
+	}
+      }
+
+    // counts sampled events, the plan is reordered every reorder_period of them
+    void sampled(uint64_t events) const
+    {
+      uint64_t before = _samples / reorder_period;
+      _samples += events;
+      if (_samples / reorder_period != before)
+	reorder();
+    }
+
+    // puts the cheapest and most decisive operands first and emits the code again
+    void reorder() const;
+    void emit() const;
+
+    void print(std::ostream& out) const;
+    void print(std::ostream& out, const instruction& i) const;
+    void print_plan(std::ostream& out) const;
+
+    // The order of the operands changes while running and batches reuse
+    // their columns, which is why these are mutable. A program is owned by
+    // one pipeline stage at a time.
+    mutable std::vector<instruction> _code{};
+    mutable std::vector<plan_node> _plan{};
+    mutable uint64_t _runs{};
+    mutable uint64_t _samples{};
+    mutable batch_columns _columns{};
+    uint32_t _root{};
+    uint32_t _depth{}; // of the plan, for the masks of select()
+    bool _adaptive{};
+
+    std::string _strings{}; // operands are offsets, so copies stay valid
+    automaton _automata[2]{};
+    std::vector<number_set> _numberSets{};
+    std::vector<string_set> _stringSets{};
+    std::shared_ptr<interner::pin_set> _pins{}; // the symbols of the operands, shared by the copies
+  };
+}
@@ -0,0 +1,242 @@
+#include "rule_set.h"
+#include "spdlog/spdlog.h"
+
+#include <boost/variant/apply_visitor.hpp>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "fmt/format.h"
+
+namespace
+{
+  namespace ast = lspredicate::ast;
+
+  // `(a || b)` as branches a and b, with nested groups flattened
+  struct Branches
+  {
+    typedef void result_type;
+
+    std::vector<ast::operand>& _out;
+
+    void operator()(ast::disjunctive_expression const& ast) const
+    {
+      boost::apply_visitor(*this, ast.head);
+      for (const auto& operation : ast.tail)
+	boost::apply_visitor(*this, operation.operand_);
+    }
+
+    void operator()(ast::conjunctive_expression const& ast) const
+    {
+      if (ast.tail.empty())
+	boost::apply_visitor(*this, ast.head);
+      else
+	_out.emplace_back(ast);
+    }
+
+    void operator()(ast::comparison const& ast) const
+    {
+      _out.emplace_back(ast);
+    }
+
+    void operator()(ast::negated const& ast) const
+    {
+      _out.emplace_back(ast);
+    }
+
+    void operator()(bool ast) const
+    {
+      _out.emplace_back(ast);
+    }
+  };
+
+  // `(a && b)` as conjuncts a and b, with nested groups flattened
+  struct Conjuncts
+  {
+    typedef void result_type;
+
+    std::vector<ast::operand>& _out;
+
+    void operator()(ast::conjunctive_expression const& ast) const
+    {
+      boost::apply_visitor(*this, ast.head);
+      for (const auto& operation : ast.tail)
+	boost::apply_visitor(*this, operation.operand_);
+    }
+
+    void operator()(ast::disjunctive_expression const& ast) const
+    {
+      if (ast.tail.empty())
+	boost::apply_visitor(*this, ast.head);
+      else
+	_out.emplace_back(ast);
+    }
+
+    void operator()(ast::comparison const& ast) const
+    {
+      _out.emplace_back(ast);
+    }
+
+    void operator()(ast::negated const& ast) const
+    {
+      _out.emplace_back(ast);
+    }
+
+    void operator()(bool ast) const
+    {
+      _out.emplace_back(ast);
+    }
+  };
+
+  // kernel paths are absolute and normalized, a key like that needs no
+  // comparison after the trie has matched it
+  bool canonical(const std::string& path)
+  {
+    if (path.size() < 2 || path.front() != '/')
+      return false;
+    if (path.find("//") != std::string::npos)
+      return false;
+    auto components = lspredicate::path_trie::split(path);
+    for (auto component : components)
+      if (component == "." || component == "..")
+	return false;
+    return true;
+  }
+
+  struct Key
+  {
+    std::vector<std::string> _exact{};
+    std::string _subtree{};
+    bool _keep{}; // the comparison has to stay in the residual
+  };
+
+  bool key(const ast::operand& operand, Key& key)
+  {
+    auto comparison = boost::get<boost::spirit::x3::forward_ast<ast::comparison>>(&operand);
+    if (!comparison || comparison->get().identifier != ast::comparison_identifier::FILE_PATH)
+      return false;
+
+    const auto& operation = comparison->get().operation_;
+    if (operation.operator_ == ast::comparison_operator::EQ
+	|| operation.operator_ == ast::comparison_operator::IN)
+    {
+      if (auto path = boost::get<std::string>(&operation.operand_))
+	key._exact.push_back(*path);
+      else if (auto paths = boost::get<std::vector<std::string>>(&operation.operand_))
+	key._exact = *paths;
+      else
+	return false;
+      for (const auto& path : key._exact)
+      {
+	if (!canonical(path) || path.back() == '/')
+	  return false;
+      }
+      return true;
+    }
+    else if (operation.operator_ == ast::comparison_operator::PREFIX)
+    {
+      auto prefix = boost::get<std::string>(&operation.operand_);
+      if (!prefix || prefix->empty() || prefix->front() != '/')
+	return false;
+      // everything under the last complete directory of the prefix
+      key._subtree = prefix->substr(0, prefix->rfind('/') + 1);
+      if (key._subtree.size() > 1 && !canonical(key._subtree))
+	return false;
+      key._keep = (key._subtree != *prefix);
+      return true;
+    }
+    return false;
+  }
+
+  ast::expression conjunction(const std::vector<ast::operand>& operands)
+  {
+    ast::expression expression;
+    if (operands.empty())
+    {
+      expression.head = true;
+      return expression;
+    }
+    ast::conjunctive_expression conjunctive;
+    conjunctive.head = operands.front();
+    for (size_t i = 1; i < operands.size(); ++i)
+    {
+      ast::conjunctive_operation operation;
+      operation.operand_ = operands[i];
+      conjunctive.tail.push_back(operation);
+    }
+    expression.head = conjunctive;
+    return expression;
+  }
+}
+
+lsp::predicate::RuleSet::RuleSet(const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in.is_open())
+    throw std::runtime_error(fmt::format("Unable to read rules from '{0}'", path));
+
+  std::string line;
+  size_t number = 0;
+  while (std::getline(in, line))
+  {
+    ++number;
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+      continue;
+    size_t colon = line.find(':', first);
+    if (colon == std::string::npos || colon == first) // no colon, or no name before it
+      throw std::runtime_error(fmt::format("{0}:{1}: a rule is 'NAME: EXPRESSION'", path, number));
+    size_t last = line.find_last_not_of(" \t", colon - 1);
+    add(line.substr(first, last - first + 1), line.substr(colon + 1));
+  }
+}
+
+void lsp::predicate::RuleSet::add(const std::string& name, const std::string& expression)
+{
+  Index& index = *_index;
+  uint32_t rule = static_cast<uint32_t>(index._rules.size());
+  index._rules.push_back(Rule{name, CmdlExpression(expression)});
+
+  const CmdlExpression& parsed = index._rules.back()._expression;
+  std::vector<ast::operand> branches;
+  if (parsed.empty())
+    branches.emplace_back(true);
+  else
+    Branches{branches}(parsed._expr);
+
+  for (const auto& operand : branches)
+  {
+    std::vector<ast::operand> conjuncts;
+    boost::apply_visitor(Conjuncts{conjuncts}, operand);
+
+    uint32_t branch = static_cast<uint32_t>(index._branches.size());
+    Key k;
+    auto keyed = std::find_if(conjuncts.begin(), conjuncts.end()
+	, [&k](const ast::operand& conjunct){k = Key{}; return key(conjunct, k);});
+
+    if (keyed == conjuncts.end())
+      index._unindexed.push_back(branch);
+    else
+    {
+      for (const auto& path : k._exact)
+	index._trie.add_exact(path, branch);
+      if (!k._subtree.empty())
+	index._trie.add_subtree(k._subtree, branch);
+      if (!k._keep)
+	conjuncts.erase(keyed);
+      ++index._indexed;
+    }
+    // the index is shared between copies, so residuals keep the order they were compiled in
+    index._branches.push_back(Branch{rule, lspredicate::program(conjunction(conjuncts), false)});
+  }
+}
+
+void lsp::predicate::RuleSet::report() const
+{
+  spdlog::info("Rules: {0} with {1} branches, {2} indexed by path, {3} checked for every event"
+      , _index->_rules.size()
+      , _index->_branches.size()
+      , _index->_indexed
+      , _index->_unindexed.size()
+      );
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "lspredicate/cmdl_expression.h"
+#include "lspredicate/path_trie.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+namespace lsp
+{
+  namespace predicate
+  {
+    // Many named predicates evaluated together. Every `||` branch of a rule
+    // that pins the file with ==, `in [...]` or ^= is indexed by that path
+    // in a trie, so an event walks the trie once and evaluates only what
+    // is left of the branches found there. Branches with no file constraint
+    // are evaluated for every event.
+    struct RuleSet
+    {
+      struct Rule
+      {
+	std::string _name{};
+	CmdlExpression _expression;
+      };
+
+      struct Branch
+      {
+	uint32_t _rule{};
+	lspredicate::program _residual{};
+      };
+
+      struct Index
+      {
+	std::vector<Rule> _rules{};
+	std::vector<Branch> _branches{};
+	std::vector<uint32_t> _unindexed{}; // branches checked for every event
+	lspredicate::path_trie _trie{};
+	size_t _indexed{};
+      };
+
+      RuleSet() = default;
+      explicit RuleSet(const std::string& path); // `NAME: EXPRESSION` per line
+
+      void add(const std::string& name, const std::string& expression);
+      void report() const;
+
+      bool empty() const {return _index->_rules.empty();}
+
+      // calls f(const Rule&) once for every rule the event matches
+      template<typename T, typename F>
+	void match(const T& value, F&& f) const
+	{
+	  if (++_generation == 0)
+	  {
+	    std::fill(_seen.begin(), _seen.end(), 0);
+	    _generation = 1;
+	  }
+	  _seen.resize(_index->_rules.size());
+
+	  auto check = [this, &value, &f](uint32_t b)
+	  {
+	    const Branch& branch = _index->_branches[b];
+	    if (_seen[branch._rule] != _generation && evaluate(value, branch._residual))
+	    {
+	      _seen[branch._rule] = _generation;
+	      f(_index->_rules[branch._rule]);
+	    }
+	  };
+	  _index->_trie.find(event_traits<T>::filename(value), check);
+	  for (uint32_t b : _index->_unindexed)
+	    check(b);
+	}
+
+      // as a predicate: any rule matches
+      template<typename T>
+	bool operator()(const T& value) const
+	{
+	  bool matched = false;
+	  auto check = [this, &value, &matched](uint32_t b)
+	  {
+	    matched = matched || evaluate(value, _index->_branches[b]._residual);
+	  };
+	  _index->_trie.find(event_traits<T>::filename(value), check);
+	  for (auto it = _index->_unindexed.begin(); !matched && it != _index->_unindexed.end(); ++it)
+	    check(*it);
+	  return matched;
+	}
+
+      // copies share the index, the filter stages get a copy each
+      std::shared_ptr<Index> _index = std::make_shared<Index>();
+      mutable std::vector<uint32_t> _seen{};
+      mutable uint32_t _generation{};
+    };
+
+  } // predicate
+} // lsp
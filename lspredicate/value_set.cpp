@@ -0,0 +1,84 @@
+#include "value_set.hpp"
+
+#include <algorithm>
+
+namespace lspredicate
+{
+  namespace
+  {
+    // a power of two with the load factor at most 1/2
+    uint64_t capacity(size_t size)
+    {
+      uint64_t capacity = 2;
+      while (capacity < 2 * size)
+	capacity <<= 1;
+      return capacity;
+    }
+  }
+
+  void number_set::build(std::vector<long> values)
+  {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    _size = values.size();
+    _bits.clear();
+    _slots.clear();
+    _hasEmpty = false;
+    if (values.empty())
+    {
+      _slots.assign(2, empty);
+      _mask = 1;
+      return;
+    }
+
+    // a bitmap when it takes no more than a table would: 128 bits per value
+    uint64_t range = static_cast<uint64_t>(values.back()) - static_cast<uint64_t>(values.front()) + 1;
+    if (range != 0 && range / 128 <= values.size())
+    {
+      _min = values.front();
+      _range = range;
+      _bits.assign((range + 63) / 64, 0);
+      for (long value : values)
+      {
+	uint64_t offset = static_cast<uint64_t>(value) - static_cast<uint64_t>(_min);
+	_bits[offset >> 6] |= (uint64_t(1) << (offset & 63));
+      }
+      return;
+    }
+
+    _slots.assign(capacity(values.size()), empty);
+    _mask = _slots.size() - 1;
+    for (long value : values)
+    {
+      if (value == empty)
+      {
+	_hasEmpty = true;
+	continue;
+      }
+      uint64_t slot = hash(value) & _mask;
+      while (_slots[slot] != empty)
+	slot = (slot + 1) & _mask;
+      _slots[slot] = value;
+    }
+  }
+
+  void string_set::build(const std::vector<std::string>& values)
+  {
+    _slots.assign(capacity(values.size()), entry{});
+    _mask = _slots.size() - 1;
+    _pool.clear();
+    _size = 0;
+    for (const auto& value : values)
+    {
+      if (contains(value))
+	continue;
+      uint64_t h = hash(value);
+      uint64_t slot = h & _mask;
+      while (_slots[slot].length != free)
+	slot = (slot + 1) & _mask;
+      _slots[slot] = entry{h, static_cast<uint32_t>(_pool.size()), static_cast<uint32_t>(value.size())};
+      _pool += value;
+      ++_size;
+    }
+  }
+}
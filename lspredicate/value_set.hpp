@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
+
+namespace lspredicate
+{
+  // Integer set for `in`: a bitmap when the values are dense enough,
+  // an open addressing table otherwise. Either way a lookup is O(1).
+  struct number_set
+  {
+    void build(std::vector<long> values);
+
+    bool contains(long value) const
+    {
+      if (!_bits.empty())
+      {
+	uint64_t offset = static_cast<uint64_t>(value) - static_cast<uint64_t>(_min);
+	return offset < _range && (_bits[offset >> 6] >> (offset & 63)) & 1;
+      }
+      if (value == empty)
+	return _hasEmpty;
+      for (uint64_t slot = hash(value) & _mask; ; slot = (slot + 1) & _mask)
+      {
+	if (_slots[slot] == value)
+	  return true;
+	if (_slots[slot] == empty)
+	  return false;
+      }
+    }
+
+    size_t size() const {return _size;}
+
+    static constexpr long empty = std::numeric_limits<long>::min(); // marks a free slot
+
+    static uint64_t hash(long value)
+    {
+      uint64_t h = static_cast<uint64_t>(value) * 0x9e3779b97f4a7c15ULL;
+      return h ^ (h >> 29);
+    }
+
+    long _min{};
+    uint64_t _range{};
+    std::vector<uint64_t> _bits{};
+
+    std::vector<long> _slots = std::vector<long>(2, empty);
+    uint64_t _mask{1};
+    bool _hasEmpty{};
+
+    size_t _size{};
+  };
+
+  // String set for `in`: open addressing over one pool of characters,
+  // slots keep the hash so most probes never touch the pool.
+  struct string_set
+  {
+    void build(const std::vector<std::string>& values);
+
+    bool contains(std::string_view value) const
+    {
+      uint64_t h = hash(value);
+      for (uint64_t slot = h & _mask; ; slot = (slot + 1) & _mask)
+      {
+	const entry& e = _slots[slot];
+	if (e.length == free)
+	  return false;
+	if (e.hash == h && e.length == value.size()
+	    && std::string_view(_pool.data() + e.offset, e.length) == value)
+	  return true;
+      }
+    }
+
+    size_t size() const {return _size;}
+
+    static uint64_t hash(std::string_view value)
+    {
+      uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+      for (unsigned char c : value)
+      {
+	h ^= c;
+	h *= 0x100000001b3ULL;
+      }
+      return h;
+    }
+
+    static constexpr uint32_t free = ~uint32_t(0);
+
+    struct entry
+    {
+      uint64_t hash{};
+      uint32_t offset{};
+      uint32_t length{free};
+    };
+
+    std::vector<entry> _slots = std::vector<entry>(1);
+    std::string _pool{};
+    uint64_t _mask{};
+    size_t _size{};
+  };
+}